@@ -2,6 +2,17 @@
 #include <vector>
 #include <string>
 #include <fstream>
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <tuple>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
 
 using namespace std;
 
@@ -31,8 +42,8 @@ private:
 public:
     Discipline(const string& n, const string& c) : name(n), code(c) {}
 
-    string getName() const { return name; }
-    string getCode() const { return code; }
+    const string& getName() const { return name; }
+    const string& getCode() const { return code; }
 
     void display() const {
         cout << ": " << name << " (" << code << ")";
@@ -85,6 +96,10 @@ public:
         supervisor = sup;
     }
 
+    const CommunityMember* getSupervisor() const {
+        return supervisor;
+    }
+
     void display() const override {
         Student::display();
         cout << " : ";
@@ -122,6 +137,10 @@ public:
         }
     }
 
+    const vector<pair<Discipline, vector<Student*>>>& getTeachingGroups() const {
+        return teachingGroups;
+    }
+
     void assignGroupToDiscipline(const Discipline& disc, const vector<Student*>& group) {
 
         teachingGroups.emplace_back(disc, group);
@@ -147,6 +166,769 @@ public:
     }
 };
 
+//     .  SSE2 
+//           .
+vector<int> intersectSorted(const vector<int>& a, const vector<int>& b) {
+    vector<int> result;
+    result.reserve(min(a.size(), b.size()));
+    size_t i = 0, j = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+    while (i + 4 <= a.size() && j + 4 <= b.size()) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a.data() + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b.data() + j));
+        __m128i equal = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi32(va, vb), _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x39))),
+            _mm_or_si128(_mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x4E)), _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x93))));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(equal));
+        for (int k = 0; k < 4; k++) {
+            if (mask & (1 << k))
+                result.push_back(a[i + k]);
+        }
+        int lastA = a[i + 3];
+        int lastB = b[j + 3];
+        if (lastA <= lastB) i += 4;
+        if (lastB <= lastA) j += 4;
+    }
+#endif
+    while (i < a.size() && j < b.size()) {
+        if (a[i] < b[j]) {
+            i++;
+        } else if (b[j] < a[i]) {
+            j++;
+        } else {
+            result.push_back(a[i]);
+            i++;
+            j++;
+        }
+    }
+    return result;
+}
+
+
+//    :     
+//         .    
+//   (   cp1251,    ).
+class NameIndex {
+private:
+    //    :     
+    //  labels,   ,   -   slotEntries
+    struct TrieNode {
+        uint32_t labelStart;
+        uint32_t labelLength;
+        int firstChild;
+        int nextSibling;
+        int firstSlot;
+        char firstChar; //    ,    labels   
+    };
+
+    vector<TrieNode> trie;
+    string labels;
+    vector<pair<int, int>> slotEntries; //     
+    vector<int> ids;
+    //     :   s - [firstWord[s], firstWord[s + 1])
+    vector<int> firstWord;
+    vector<int> wordSlots;
+    unordered_map<uint32_t, vector<int>> postings; //  ->   
+    //   :   s - [nameStarts[s], nameStarts[s + 1])
+    string names;
+    vector<size_t> nameStarts;
+
+    //         
+    static constexpr size_t PostingBudget = 1 << 16;
+
+    static unsigned char fold(unsigned char c) {
+        if (c >= 'A' && c <= 'Z') return c + ('a' - 'A');
+        if (c >= 0xC0 && c <= 0xDF) return c + 0x20;
+        if (c == 0xA8 || c == 0xB8) return 0xE5;
+        return c;
+    }
+
+    static string normalize(const string& text) {
+        string result;
+        result.reserve(text.size());
+        for (unsigned char c : text)
+            result.push_back(static_cast<char>(fold(c)));
+        return result;
+    }
+
+    static vector<string> splitWords(const string& normalized) {
+        vector<string> result;
+        size_t start = 0;
+        while (start < normalized.size()) {
+            size_t end = normalized.find(' ', start);
+            if (end == string::npos)
+                end = normalized.size();
+            if (end > start)
+                result.push_back(normalized.substr(start, end - start));
+            start = end + 1;
+        }
+        return result;
+    }
+
+    //   ,     ;
+    //  closed -   ,   
+    static vector<uint32_t> trigrams(const string& word, bool closed = true) {
+        string padded = "  " + word + (closed ? " " : "");
+        vector<uint32_t> result;
+        for (size_t i = 0; i + 3 <= padded.size(); i++) {
+            result.push_back((uint32_t(uint8_t(padded[i])) << 16) |
+                             (uint32_t(uint8_t(padded[i + 1])) << 8) | uint8_t(padded[i + 2]));
+        }
+        sort(result.begin(), result.end());
+        result.erase(unique(result.begin(), result.end()), result.end());
+        return result;
+    }
+
+    int findChild(int node, char c) const {
+        for (int child = trie[node].firstChild; child >= 0; child = trie[child].nextSibling) {
+            if (trie[child].firstChar == c)
+                return child;
+        }
+        return -1;
+    }
+
+    void addSlot(int node, int word) {
+        slotEntries.emplace_back(word, trie[node].firstSlot);
+        trie[node].firstSlot = static_cast<int>(slotEntries.size()) - 1;
+    }
+
+    void insertKey(const string& key, int word) {
+        int node = 0;
+        size_t pos = 0;
+        while (pos < key.size()) {
+            int child = findChild(node, key[pos]);
+            if (child < 0) {
+                TrieNode leaf = {static_cast<uint32_t>(labels.size()), static_cast<uint32_t>(key.size() - pos),
+                                 -1, trie[node].firstChild, -1, key[pos]};
+                labels.append(key, pos, string::npos);
+                trie[node].firstChild = static_cast<int>(trie.size());
+                trie.push_back(leaf);
+                addSlot(trie[node].firstChild, word);
+                return;
+            }
+            const TrieNode& edge = trie[child];
+            size_t common = 0;
+            while (common < edge.labelLength && pos + common < key.size() &&
+                   labels[edge.labelStart + common] == key[pos + common])
+                common++;
+            if (common < edge.labelLength) {
+                //  :         
+                TrieNode tail = {edge.labelStart + static_cast<uint32_t>(common),
+                                 edge.labelLength - static_cast<uint32_t>(common),
+                                 edge.firstChild, -1, edge.firstSlot,
+                                 labels[edge.labelStart + common]};
+                trie.push_back(tail);
+                trie[child].labelLength = static_cast<uint32_t>(common);
+                trie[child].firstChild = static_cast<int>(trie.size()) - 1;
+                trie[child].firstSlot = -1;
+            }
+            node = child;
+            pos += common;
+        }
+        addSlot(node, word);
+    }
+
+    //      ,    ,
+    //    
+    static void wordSuffixes(const string& normalized, int word, vector<pair<string, int>>& out) {
+        for (size_t start = 0; start < normalized.size(); start++) {
+            if (normalized[start] != ' ' && (start == 0 || normalized[start - 1] == ' '))
+                out.emplace_back(normalized.substr(start), word++);
+        }
+    }
+
+    // ,       -    normalized.
+    //    :  ,    
+    // (   ),     ;    bound.
+    unordered_set<int> prefixSlots(const string& normalized, size_t bound) const {
+        int node = 0;
+        size_t pos = 0;
+        while (pos < normalized.size()) {
+            int child = findChild(node, normalized[pos]);
+            if (child < 0)
+                return {};
+            const TrieNode& edge = trie[child];
+            for (size_t i = 0; i < edge.labelLength && pos < normalized.size(); i++, pos++) {
+                if (labels[edge.labelStart + i] != normalized[pos])
+                    return {};
+            }
+            node = child;
+        }
+        unordered_set<int> found;
+        vector<int> level(1, node);
+        while (!level.empty() && found.size() < bound) {
+            vector<int> next;
+            for (int current : level) {
+                for (int entry = trie[current].firstSlot; entry >= 0 && found.size() < bound;
+                     entry = slotEntries[entry].second)
+                    found.insert(wordSlots[slotEntries[entry].first]);
+                for (int child = trie[current].firstChild; child >= 0; child = trie[child].nextSibling)
+                    next.push_back(child);
+            }
+            level.swap(next);
+        }
+        return found;
+    }
+
+    //  ;     ,   
+    //      
+    struct QueryWord {
+        string text;
+        vector<uint32_t> grams;
+        vector<uint32_t> openGrams;
+    };
+
+    static vector<QueryWord> parseQuery(const vector<string>& words) {
+        vector<QueryWord> result;
+        for (const string& word : words)
+            result.push_back(QueryWord{word, trigrams(word), trigrams(word, false)});
+        return result;
+    }
+
+    static string joinWords(const vector<string>& words) {
+        string result;
+        for (const string& word : words) {
+            if (!result.empty())
+                result += ' ';
+            result += word;
+        }
+        return result;
+    }
+
+    static double dice(const vector<uint32_t>& a, const vector<uint32_t>& b) {
+        size_t shared = 0;
+        for (size_t i = 0, j = 0; i < a.size() && j < b.size();) {
+            if (a[i] < b[j]) {
+                i++;
+            } else if (b[j] < a[i]) {
+                j++;
+            } else {
+                shared++;
+                i++;
+                j++;
+            }
+        }
+        return a.empty() && b.empty() ? 0.0 : 2.0 * shared / (a.size() + b.size());
+    }
+
+    //  :        
+    //  (   ),  . 
+    //     +2,        
+    //  +1;        , +0.5,  
+    //   ,  +1.
+    double scoreSlot(int slot, const vector<QueryWord>& query, const string& joined, bool prefixMatch) const {
+        vector<string> nameWords = splitWords(names.substr(nameStarts[slot], nameStarts[slot + 1] - nameStarts[slot]));
+        vector<vector<uint32_t>> nameGrams;
+        for (const string& word : nameWords)
+            nameGrams.push_back(trigrams(word));
+
+        double total = 0;
+        bool allContained = true;
+        bool allWhole = true;
+        for (size_t i = 0; i < query.size(); i++) {
+            double best = 0;
+            bool contained = false;
+            bool whole = false;
+            for (size_t j = 0; j < nameGrams.size(); j++) {
+                const vector<uint32_t>& grams = nameGrams[j];
+                best = max(best, dice(query[i].grams, grams));
+                if (i + 1 == query.size())
+                    best = max(best, dice(query[i].openGrams, grams));
+                contained = contained || includes(grams.begin(), grams.end(), query[i].grams.begin(), query[i].grams.end());
+                whole = whole || nameWords[j] == query[i].text;
+            }
+            total += best;
+            allContained = allContained && contained;
+            allWhole = allWhole && whole;
+        }
+        double score = total / query.size();
+        if (prefixMatch)
+            score += 2.0;
+        else if (allContained)
+            score += 1.0;
+        if (allWhole)
+            score += 0.5;
+        if (joinWords(nameWords) == joined)
+            score += 1.0;
+        return score;
+    }
+
+    //      ,     
+    //  PostingBudget:    "  "  " "    ,
+    //        
+    vector<const vector<int>*> rarestLists(const vector<uint32_t>& grams, bool& complete) const {
+        vector<const vector<int>*> lists;
+        for (uint32_t gram : grams) {
+            auto it = postings.find(gram);
+            if (it != postings.end())
+                lists.push_back(&it->second);
+        }
+        complete = lists.size() == grams.size();
+        sort(lists.begin(), lists.end(), [](const vector<int>* a, const vector<int>* b) {
+            return a->size() < b->size();
+        });
+        size_t used = 0;
+        size_t total = 0;
+        while (used < lists.size() && total + lists[used]->size() <= PostingBudget)
+            total += lists[used++]->size();
+        lists.resize(used);
+        return lists;
+    }
+
+    // ,      , -  
+    void containingCandidates(const vector<uint32_t>& grams, size_t bound, unordered_set<int>& out) const {
+        bool complete;
+        vector<const vector<int>*> lists = rarestLists(grams, complete);
+        if (!complete || lists.empty())
+            return;
+        vector<int> common = *lists[0];
+        for (size_t i = 1; i < lists.size() && !common.empty(); i++)
+            common = intersectSorted(common, *lists[i]);
+        for (size_t i = 0; i < common.size() && i < bound; i++)
+            out.insert(wordSlots[common[i]]);
+    }
+
+    //         ,   -
+    //     .    ,    
+    // ,      ,  -.
+    void similarCandidates(const vector<QueryWord>& query, size_t queryLength, size_t bound,
+                           unordered_set<int>& out) const {
+        vector<int> hits;
+        for (const QueryWord& word : query) {
+            bool complete;
+            for (const vector<int>* list : rarestLists(word.grams, complete)) {
+                size_t middle = hits.size();
+                for (int entry : *list)
+                    hits.push_back(wordSlots[entry]);
+                inplace_merge(hits.begin(), hits.begin() + middle, hits.end());
+            }
+        }
+        // (-  ,  , ):   - 
+        vector<tuple<int, size_t, int>> ranked;
+        for (size_t i = 0; i < hits.size();) {
+            size_t j = i;
+            while (j < hits.size() && hits[j] == hits[i])
+                j++;
+            size_t length = nameStarts[hits[i] + 1] - nameStarts[hits[i]];
+            size_t distance = length > queryLength ? length - queryLength : queryLength - length;
+            ranked.emplace_back(-static_cast<int>(j - i), distance, hits[i]);
+            i = j;
+        }
+        if (ranked.size() > bound) {
+            nth_element(ranked.begin(), ranked.begin() + bound, ranked.end());
+            ranked.resize(bound);
+        }
+        for (const auto& entry : ranked)
+            out.insert(get<2>(entry));
+    }
+
+    static size_t candidateBound(size_t limit) {
+        return max<size_t>(limit * 16, 256);
+    }
+
+    //  limit    (  -  ),    ID
+    void rank(vector<pair<int, double>>& scored, size_t limit) const {
+        auto better = [](const pair<int, double>& a, const pair<int, double>& b) {
+            return a.second != b.second ? a.second > b.second : a.first < b.first;
+        };
+        if (scored.size() > limit) {
+            nth_element(scored.begin(), scored.begin() + limit, scored.end(), better);
+            scored.resize(limit);
+        }
+        sort(scored.begin(), scored.end(), better);
+        for (auto& entry : scored)
+            entry.first = ids[entry.first];
+    }
+
+public:
+    NameIndex() : trie(1, TrieNode{0, 0, -1, -1, -1, 0}), firstWord(1, 0), nameStarts(1, 0) {}
+
+    //     ;      threadCount 
+    static NameIndex build(const vector<CommunityMember*>& members,
+                           unsigned threadCount = thread::hardware_concurrency()) {
+        NameIndex index;
+        size_t count = members.size();
+        vector<string> normalized(count);
+        index.ids.resize(count);
+        index.firstWord.assign(count + 1, 0);
+
+        threadCount = max(1u, min<unsigned>(threadCount, static_cast<unsigned>(max<size_t>(count / 1024, 1))));
+        auto inParallel = [&](auto body) {
+            vector<thread> workers;
+            for (unsigned t = 0; t < threadCount; t++)
+                workers.emplace_back(body, t, count * t / threadCount, count * (t + 1) / threadCount);
+            for (auto& worker : workers)
+                worker.join();
+        };
+
+        inParallel([&](unsigned, size_t begin, size_t end) {
+            for (size_t slot = begin; slot < end; slot++) {
+                normalized[slot] = normalize(members[slot]->getName());
+                index.ids[slot] = members[slot]->getId();
+                index.firstWord[slot + 1] = static_cast<int>(splitWords(normalized[slot]).size());
+            }
+        });
+        for (size_t slot = 0; slot < count; slot++)
+            index.firstWord[slot + 1] += index.firstWord[slot];
+        index.wordSlots.resize(index.firstWord[count]);
+        index.nameStarts.resize(count + 1);
+        for (size_t slot = 0; slot < count; slot++) {
+            index.names += normalized[slot];
+            index.nameStarts[slot + 1] = index.names.size();
+        }
+
+        vector<unordered_map<uint32_t, vector<int>>> partial(threadCount);
+        inParallel([&](unsigned t, size_t begin, size_t end) {
+            for (size_t slot = begin; slot < end; slot++) {
+                int word = index.firstWord[slot];
+                for (const string& text : splitWords(normalized[slot])) {
+                    index.wordSlots[word] = static_cast<int>(slot);
+                    for (uint32_t gram : trigrams(text))
+                        partial[t][gram].push_back(word);
+                    word++;
+                }
+            }
+        });
+
+        //      ,  
+        //      
+        for (auto& part : partial) {
+            for (auto& entry : part) {
+                vector<int>& list = index.postings[entry.first];
+                list.insert(list.end(), entry.second.begin(), entry.second.end());
+            }
+        }
+        //     :   
+        //     ,       
+        vector<pair<string, int>> keys;
+        for (size_t slot = 0; slot < count; slot++)
+            wordSuffixes(normalized[slot], index.firstWord[slot], keys);
+        sort(keys.begin(), keys.end());
+        for (const auto& key : keys)
+            index.insertKey(key.first, key.second);
+        return index;
+    }
+
+    void add(const CommunityMember& member) {
+        int slot = static_cast<int>(ids.size());
+        int word = firstWord.back();
+        string normalized = normalize(member.getName());
+        ids.push_back(member.getId());
+        names += normalized;
+        nameStarts.push_back(names.size());
+        for (const string& text : splitWords(normalized)) {
+            wordSlots.push_back(slot);
+            for (uint32_t gram : trigrams(text))
+                postings[gram].push_back(static_cast<int>(wordSlots.size()) - 1);
+        }
+        firstWord.push_back(static_cast<int>(wordSlots.size()));
+        vector<pair<string, int>> keys;
+        wordSuffixes(normalized, word, keys);
+        for (const auto& key : keys)
+            insertKey(key.first, key.second);
+    }
+
+    // ID ,        prefix;   
+    vector<int> findByPrefix(const string& prefix, size_t limit = 10) const {
+        vector<string> words = splitWords(normalize(prefix));
+        if (words.empty())
+            return {};
+        vector<QueryWord> query = parseQuery(words);
+        string joined = joinWords(words);
+        vector<pair<int, double>> ranked;
+        for (int slot : prefixSlots(joined, candidateBound(limit)))
+            ranked.emplace_back(slot, scoreSlot(slot, query, joined, true));
+        rank(ranked, limit);
+        vector<int> result;
+        for (const auto& entry : ranked)
+            result.push_back(entry.first);
+        return result;
+    }
+
+    //   :    ,   
+    //      ,   (. scoreSlot).
+    //      limit    
+    //  .
+    vector<pair<int, double>> search(const string& query, size_t limit = 10, double minScore = 0.3) const {
+        vector<string> words = splitWords(normalize(query));
+        if (words.empty())
+            return {};
+        vector<QueryWord> parsed = parseQuery(words);
+        string joined = joinWords(words);
+        size_t bound = candidateBound(limit);
+
+        unordered_set<int> prefixed = prefixSlots(joined, bound);
+        unordered_set<int> candidates = prefixed;
+        for (const QueryWord& word : parsed)
+            containingCandidates(word.grams, bound, candidates);
+
+        vector<pair<int, double>> scored;
+        size_t strong = 0;
+        auto score = [&](int slot) {
+            double value = scoreSlot(slot, parsed, joined, prefixed.count(slot) > 0);
+            if (value >= 1.0)
+                strong++;
+            if (value >= minScore)
+                scored.emplace_back(slot, value);
+        };
+        for (int slot : candidates)
+            score(slot);
+        //   ,        limit
+        if (strong < limit) {
+            unordered_set<int> similar;
+            similarCandidates(parsed, joined.size(), bound, similar);
+            for (int slot : similar) {
+                if (!candidates.count(slot))
+                    score(slot);
+            }
+        }
+        rank(scored, limit);
+        return scored;
+    }
+
+    size_t size() const {
+        return ids.size();
+    }
+};
+
+
+//   [0, count)  threadCount     
+// : f( , , )
+template <typename F>
+void parallelFor(size_t count, unsigned threadCount, F f) {
+    if (threadCount <= 1) {
+        f(0u, size_t(0), count);
+        return;
+    }
+    vector<thread> workers;
+    for (unsigned t = 0; t < threadCount; t++) {
+        workers.emplace_back([&f, t, count, threadCount]() {
+            f(t, count * t / threadCount, count * (t + 1) / threadCount);
+        });
+    }
+    for (auto& worker : workers)
+        worker.join();
+}
+
+
+//      : i-  -  memberIds[i],
+// disciplines[i], teacherIds[i].    .
+struct EnrollmentTable {
+    vector<int> memberIds;
+    vector<int> disciplines;
+    vector<int> teacherIds; // -1,    
+    vector<Discipline> disciplineCatalog; //  -> 
+    vector<int> studentIds;
+    vector<int> supervisedIds;
+    vector<int> supervisorIds;
+
+    size_t size() const {
+        return memberIds.size();
+    }
+};
+
+
+//    :    
+//         
+class EnrollmentAnalytics {
+private:
+    EnrollmentTable table;
+    unsigned threadCount;
+
+    static constexpr size_t RowsPerThread = 1 << 16;
+
+    unsigned threadsFor(size_t rows) const {
+        return static_cast<unsigned>(max<size_t>(1, min<size_t>(threadCount, rows / RowsPerThread)));
+    }
+
+    //           ,
+    //   p      
+    vector<pair<int, size_t>> countBy(const vector<int>& keys, int skipKey) const {
+        unsigned threads = threadsFor(keys.size());
+        vector<vector<unordered_map<int, size_t>>> local(threads, vector<unordered_map<int, size_t>>(threads));
+        parallelFor(keys.size(), threads, [&](unsigned t, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                int key = keys[i];
+                if (key != skipKey)
+                    local[t][hash<int>()(key) % threads][key]++;
+            }
+        });
+
+        vector<unordered_map<int, size_t>> merged(threads);
+        parallelFor(threads, threads, [&](unsigned, size_t begin, size_t end) {
+            for (size_t partition = begin; partition < end; partition++) {
+                for (unsigned t = 0; t < threads; t++) {
+                    for (const auto& entry : local[t][partition])
+                        merged[partition][entry.first] += entry.second;
+                }
+            }
+        });
+
+        vector<pair<int, size_t>> result;
+        for (const auto& partition : merged)
+            result.insert(result.end(), partition.begin(), partition.end());
+        sort(result.begin(), result.end(), [](const pair<int, size_t>& a, const pair<int, size_t>& b) {
+            return a.second != b.second ? a.second > b.second : a.first < b.first;
+        });
+        return result;
+    }
+
+    //  :  ->  -> .    
+    //  ,      .
+    using DisciplineHandles = unordered_map<string, unordered_map<string, int>>;
+
+    static int internDiscipline(DisciplineHandles& handles, vector<Discipline>& catalog, const Discipline& disc) {
+        unordered_map<string, int>& byName = handles[disc.getCode()];
+        auto it = byName.find(disc.getName());
+        if (it != byName.end())
+            return it->second;
+        byName.emplace(disc.getName(), static_cast<int>(catalog.size()));
+        catalog.push_back(disc);
+        return static_cast<int>(catalog.size()) - 1;
+    }
+
+    static uint64_t enrollmentKey(int memberId, int discipline) {
+        return (uint64_t(uint32_t(memberId)) << 32) | uint32_t(discipline);
+    }
+
+    //    :     
+    //    ,      
+    void extract(const vector<CommunityMember*>& members) {
+        vector<const Student*> students;
+        for (const auto* member : members) {
+            if (const auto* student = dynamic_cast<const Student*>(member)) {
+                students.push_back(student);
+                table.studentIds.push_back(student->getId());
+            }
+            if (const auto* graduate = dynamic_cast<const GraduateStudent*>(member)) {
+                if (graduate->getSupervisor()) {
+                    table.supervisedIds.push_back(graduate->getId());
+                    table.supervisorIds.push_back(graduate->getSupervisor()->getId());
+                }
+            }
+        }
+
+        struct Part {
+            vector<int> memberIds;
+            vector<int> disciplines;
+            vector<int> teacherIds;
+            vector<Discipline> catalog;
+        };
+        unsigned threads = max(1u, min<unsigned>(threadCount, static_cast<unsigned>(students.size() / 4096)));
+        vector<Part> parts(threads);
+        parallelFor(students.size(), threads, [&](unsigned t, size_t begin, size_t end) {
+            Part& part = parts[t];
+            DisciplineHandles handles;
+            for (size_t i = begin; i < end; i++) {
+                for (const auto& entry : students[i]->getDisciplines()) {
+                    part.memberIds.push_back(students[i]->getId());
+                    part.disciplines.push_back(internDiscipline(handles, part.catalog, entry.first));
+                    part.teacherIds.push_back(entry.second ? entry.second->getId() : -1);
+                }
+            }
+        });
+
+        DisciplineHandles handles;
+        auto handleOf = [&](const Discipline& disc) {
+            return internDiscipline(handles, table.disciplineCatalog, disc);
+        };
+        for (auto& part : parts) {
+            vector<int> remap;
+            for (const auto& disc : part.catalog)
+                remap.push_back(handleOf(disc));
+            for (int& handle : part.disciplines)
+                handle = remap[handle];
+            table.memberIds.insert(table.memberIds.end(), part.memberIds.begin(), part.memberIds.end());
+            table.disciplines.insert(table.disciplines.end(), part.disciplines.begin(), part.disciplines.end());
+            table.teacherIds.insert(table.teacherIds.end(), part.teacherIds.begin(), part.teacherIds.end());
+        }
+
+        //    ,     
+        vector<const Teacher*> teachers;
+        for (const auto* member : members) {
+            const auto* teacher = dynamic_cast<const Teacher*>(member);
+            if (teacher && !teacher->getTeachingGroups().empty())
+                teachers.push_back(teacher);
+        }
+        if (teachers.empty())
+            return;
+        unordered_set<uint64_t> seen;
+        seen.reserve(table.size());
+        for (size_t i = 0; i < table.size(); i++)
+            seen.insert(enrollmentKey(table.memberIds[i], table.disciplines[i]));
+        for (const auto* teacher : teachers) {
+            for (const auto& group : teacher->getTeachingGroups()) {
+                int discipline = handleOf(group.first);
+                for (const auto* student : group.second) {
+                    if (!seen.insert(enrollmentKey(student->getId(), discipline)).second)
+                        continue;
+                    table.memberIds.push_back(student->getId());
+                    table.disciplines.push_back(discipline);
+                    table.teacherIds.push_back(teacher->getId());
+                }
+            }
+        }
+    }
+
+public:
+    explicit EnrollmentAnalytics(const vector<CommunityMember*>& members,
+                                 unsigned threads = thread::hardware_concurrency())
+        : threadCount(max(1u, threads)) {
+        extract(members);
+    }
+
+    const EnrollmentTable& getTable() const {
+        return table;
+    }
+
+    //     .  , 
+    //  -      .
+    vector<pair<Discipline, size_t>> enrollmentsPerDiscipline() const {
+        size_t domain = table.disciplineCatalog.size();
+        unsigned threads = threadsFor(table.size());
+        vector<vector<size_t>> local(threads, vector<size_t>(domain, 0));
+        parallelFor(table.size(), threads, [&](unsigned t, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+                local[t][table.disciplines[i]]++;
+        });
+        vector<pair<Discipline, size_t>> result;
+        for (size_t handle = 0; handle < domain; handle++) {
+            size_t total = 0;
+            for (const auto& counts : local)
+                total += counts[handle];
+            result.emplace_back(table.disciplineCatalog[handle], total);
+        }
+        stable_sort(result.begin(), result.end(), [](const pair<Discipline, size_t>& a, const pair<Discipline, size_t>& b) {
+            return a.second > b.second;
+        });
+        return result;
+    }
+
+    // ID    ,   
+    vector<pair<int, size_t>> teacherLoad() const {
+        return countBy(table.teacherIds, -1);
+    }
+
+    //      k 
+    vector<pair<size_t, size_t>> disciplinesPerStudent() const {
+        vector<pair<int, size_t>> perStudent = countBy(table.memberIds, INT_MIN);
+        unordered_map<size_t, size_t> histogram;
+        for (const auto& entry : perStudent)
+            histogram[entry.second]++;
+        if (table.studentIds.size() > perStudent.size())
+            histogram[0] += table.studentIds.size() - perStudent.size();
+        vector<pair<size_t, size_t>> result(histogram.begin(), histogram.end());
+        sort(result.begin(), result.end());
+        return result;
+    }
+
+    // ID      
+    vector<pair<int, size_t>> supervisorFanout() const {
+        return countBy(table.supervisorIds, INT_MIN);
+    }
+};
+
+
 void saveToFile(const string& filename, const vector<CommunityMember*>& members) {
     ofstream out(filename);
     if (!out) {
@@ -236,6 +1018,37 @@ int main() {
     }
 
 
+    NameIndex nameIndex = NameIndex::build(members);
+    Researcher visitor(" ", 4002, " ");
+    nameIndex.add(visitor);
+
+    cout << "\n===    ===\n";
+    for (const string& query : {string(""), string(""), string("")}) {
+        cout << query << ":";
+        for (const auto& hit : nameIndex.search(query)) {
+            cout << " " << hit.first;
+        }
+        cout << endl;
+    }
+
+
+    EnrollmentAnalytics analytics(members);
+    cout << "\n===   ===\n";
+    for (const auto& entry : analytics.enrollmentsPerDiscipline()) {
+        entry.first.display();
+        cout << ": " << entry.second << endl;
+    }
+    for (const auto& entry : analytics.teacherLoad()) {
+        cout << "  " << entry.first << ": " << entry.second << endl;
+    }
+    for (const auto& entry : analytics.disciplinesPerStudent()) {
+        cout << "  " << entry.first << " : " << entry.second << endl;
+    }
+    for (const auto& entry : analytics.supervisorFanout()) {
+        cout << "   " << entry.first << ": " << entry.second << endl;
+    }
+
+
     saveToFile("university.txt", members);
     auto loadedMembers = loadFromFile("university.txt");
 
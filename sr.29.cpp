@@ -1,6 +1,53 @@
 #include <iostream>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <cstdlib>
 #include <cstring>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <queue>
+#include <span>
 #include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <typeindex>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
 
 class GraphicObject {
 public:
@@ -8,209 +55,2867 @@ public:
     virtual void draw() const = 0;
 };
 
-class Circle : public GraphicObject {
-public:
-    void draw() const override {
-        std::cout << "Drawing Circle" << std::endl;
+class Circle : public GraphicObject {
+public:
+    void draw() const override {
+        std::cout << "Drawing Circle" << std::endl;
+    }
+};
+
+// Хранилище очереди: цепочка блоков фиксированного размера, выровненных по
+// кэш-линии. Опустевшие блоки не освобождаются, а уходят в пул для повторного использования.
+template <typename T>
+class SegmentedStorage {
+private:
+    static constexpr size_t CacheLine = 64;
+    static constexpr size_t BlockBytes = 4096;
+    static constexpr size_t BlockSize = sizeof(T) * 8 > BlockBytes ? 8 : BlockBytes / sizeof(T);
+    static constexpr size_t MaxSpareBlocks = 8;
+
+    struct alignas(CacheLine) Block {
+        alignas(T) unsigned char raw[BlockSize * sizeof(T)];
+        Block* next;
+
+        T* slot(size_t index) {
+            return std::launder(reinterpret_cast<T*>(raw)) + index;
+        }
+        const T* slot(size_t index) const {
+            return std::launder(reinterpret_cast<const T*>(raw)) + index;
+        }
+    };
+
+    Block* headBlock;
+    Block* tailBlock;
+    size_t headIndex;
+    size_t tailIndex;
+    size_t count;
+    Block* spare;
+    size_t spareCount;
+
+    Block* acquireBlock() {
+        Block* block = spare;
+        if (block) {
+            spare = block->next;
+            spareCount--;
+        } else {
+            block = new Block;
+        }
+        block->next = nullptr;
+        return block;
+    }
+
+    void releaseBlock(Block* block) {
+        if (spareCount >= MaxSpareBlocks) {
+            delete block;
+            return;
+        }
+        block->next = spare;
+        spare = block;
+        spareCount++;
+    }
+
+    T* prepareSlot() {
+        if (!tailBlock) {
+            headBlock = tailBlock = acquireBlock();
+            headIndex = tailIndex = 0;
+        } else if (tailIndex == BlockSize) {
+            tailBlock->next = acquireBlock();
+            tailBlock = tailBlock->next;
+            tailIndex = 0;
+        }
+        return tailBlock->slot(tailIndex);
+    }
+
+    // Первые k элементов головного блока уже разрушены
+    void dropFront(size_t k) {
+        headIndex += k;
+        count -= k;
+        if (count == 0) {
+            // Единственный оставшийся блок переиспользуется с начала
+            for (Block* block = headBlock->next; block; ) {
+                Block* next = block->next;
+                releaseBlock(block);
+                block = next;
+            }
+            headBlock->next = nullptr;
+            tailBlock = headBlock;
+            headIndex = tailIndex = 0;
+        } else if (headIndex == BlockSize) {
+            Block* temp = headBlock;
+            headBlock = headBlock->next;
+            headIndex = 0;
+            releaseBlock(temp);
+        }
+    }
+
+public:
+    SegmentedStorage()
+        : headBlock(nullptr), tailBlock(nullptr), headIndex(0), tailIndex(0),
+          count(0), spare(nullptr), spareCount(0) {}
+
+    SegmentedStorage(const SegmentedStorage&) = delete;
+    SegmentedStorage& operator=(const SegmentedStorage&) = delete;
+
+    ~SegmentedStorage() {
+        clear();
+        while (spare) {
+            Block* temp = spare;
+            spare = spare->next;
+            delete temp;
+        }
+    }
+
+    template <typename... Args>
+    T& emplace_back(Args&&... args) {
+        T* place = new (prepareSlot()) T(std::forward<Args>(args)...);
+        tailIndex++;
+        count++;
+        return *place;
+    }
+
+    void push_back(const T& value) {
+        emplace_back(value);
+    }
+
+    T& front() {
+        return *headBlock->slot(headIndex);
+    }
+
+    const T& front() const {
+        return *headBlock->slot(headIndex);
+    }
+
+    void push_back(T&& value) {
+        emplace_back(std::move(value));
+    }
+
+    // Дописывает диапазон поблочно, счётчик обновляется один раз на пакет.
+    // Каждый заполненный участок передаётся в onSpan(const T* data, size_t length).
+    template <typename InputIt, typename F>
+    size_t append(InputIt first, InputIt last, F&& onSpan) {
+        size_t added = 0;
+        const T* spanStart = nullptr;
+        size_t spanLength = 0;
+        try {
+            while (first != last) {
+                spanStart = prepareSlot();
+                for (size_t room = BlockSize - tailIndex; room && first != last; --room, ++first) {
+                    new (tailBlock->slot(tailIndex)) T(*first);
+                    tailIndex++;
+                    added++;
+                    spanLength++;
+                }
+                size_t length = spanLength;
+                spanLength = 0;
+                onSpan(spanStart, length);
+            }
+        } catch (...) {
+            count += added;
+            if (spanLength)
+                onSpan(spanStart, spanLength);
+            throw;
+        }
+        count += added;
+        return added;
+    }
+
+    template <typename InputIt>
+    size_t append(InputIt first, InputIt last) {
+        return append(first, last, [](const T*, size_t) {});
+    }
+
+    void pop_front() {
+        headBlock->slot(headIndex)->~T();
+        dropFront(1);
+    }
+
+    // Перемещает до n элементов из начала в out, блок за блоком
+    template <typename OutputIt>
+    size_t take(size_t n, OutputIt& out) {
+        size_t taken = 0;
+        while (taken < n && count) {
+            size_t available = std::min(BlockSize - headIndex, count);
+            size_t length = std::min(available, n - taken);
+            T* data = headBlock->slot(headIndex);
+            size_t i = 0;
+            try {
+                for (; i < length; i++) {
+                    *out = std::move(data[i]);
+                    ++out;
+                    data[i].~T();
+                }
+            } catch (...) {
+                dropFront(i);
+                throw;
+            }
+            dropFront(length);
+            taken += length;
+        }
+        return taken;
+    }
+
+    // Заранее заполняет пул блоками под n элементов
+    void reserve(size_t n) {
+        size_t blocks = (n + BlockSize - 1) / BlockSize;
+        while (spareCount < blocks) {
+            Block* block = new Block;
+            block->next = spare;
+            spare = block;
+            spareCount++;
+        }
+    }
+
+    // Обходит первые limit элементов непрерывными участками: f(const T* data, size_t length)
+    template <typename F>
+    void forEachSpan(F&& f, size_t limit = SIZE_MAX) const {
+        size_t remaining = std::min(count, limit);
+        size_t index = headIndex;
+        for (const Block* block = headBlock; block && remaining; block = block->next) {
+            size_t length = std::min(BlockSize - index, remaining);
+            f(block->slot(index), length);
+            remaining -= length;
+            index = 0;
+        }
+    }
+
+    void clear() {
+        while (count)
+            pop_front();
+        if (headBlock) {
+            releaseBlock(headBlock);
+            headBlock = tailBlock = nullptr;
+        }
+        headIndex = tailIndex = 0;
+    }
+
+    void swap(SegmentedStorage& other) {
+        std::swap(headBlock, other.headBlock);
+        std::swap(tailBlock, other.tailBlock);
+        std::swap(headIndex, other.headIndex);
+        std::swap(tailIndex, other.tailIndex);
+        std::swap(count, other.count);
+        std::swap(spare, other.spare);
+        std::swap(spareCount, other.spareCount);
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+};
+
+// Гистограмма задержек с логарифмически-линейными корзинами: 16 корзин на
+// каждую степень двойки, относительная погрешность около 6%.
+class LatencyHistogram {
+private:
+    static constexpr int SubBits = 4;
+    static constexpr uint64_t SubCount = 1 << SubBits;
+
+    std::vector<uint64_t> counts;
+    uint64_t total;
+
+    static size_t bucketOf(uint64_t value) {
+        if (value < SubCount)
+            return value;
+        int shift = std::bit_width(value) - 1 - SubBits;
+        return (shift + 1) * SubCount + ((value >> shift) - SubCount);
+    }
+
+    static uint64_t lowerBound(size_t bucket) {
+        if (bucket < SubCount)
+            return bucket;
+        size_t shift = bucket / SubCount - 1;
+        return (SubCount + bucket % SubCount) << shift;
+    }
+
+public:
+    LatencyHistogram() : counts(64 * SubCount, 0), total(0) {}
+
+    void record(uint64_t value) {
+        counts[bucketOf(value)]++;
+        total++;
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < counts.size(); i++)
+            counts[i] += other.counts[i];
+        total += other.total;
+    }
+
+    uint64_t percentile(double fraction) const {
+        uint64_t target = static_cast<uint64_t>(fraction * total);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts.size(); i++) {
+            seen += counts[i];
+            if (seen > target)
+                return lowerBound(i);
+        }
+        return 0;
+    }
+
+    uint64_t count() const {
+        return total;
+    }
+};
+
+inline uint64_t readTimestamp() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+// Политика без инструментирования: все вызовы пустые и исчезают при компиляции
+struct NoInstrumentation {
+    class Probe {
+    public:
+        explicit Probe(const std::string&) {}
+        void enqueued(size_t, size_t) {}
+        void dequeued(size_t, size_t) {}
+        void failedDequeue() {}
+    };
+};
+
+struct QueueStats {
+    std::string name;
+    uint64_t enqueues;
+    uint64_t dequeues;
+    uint64_t failedDequeues;
+    uint64_t size;
+    uint64_t peakSize;
+    LatencyHistogram waitTicks;
+};
+
+class QueueProbeBase;
+
+// Реестр живых инструментированных очередей
+class QueueRegistry {
+private:
+    std::mutex lock;
+    std::vector<QueueProbeBase*> probes;
+
+public:
+    static QueueRegistry& instance() {
+        static QueueRegistry registry;
+        return registry;
+    }
+
+    void add(QueueProbeBase* probe) {
+        std::lock_guard<std::mutex> guard(lock);
+        probes.push_back(probe);
+    }
+
+    void remove(QueueProbeBase* probe) {
+        std::lock_guard<std::mutex> guard(lock);
+        probes.erase(std::remove(probes.begin(), probes.end(), probe), probes.end());
+    }
+
+    std::vector<QueueStats> snapshot();
+    void exportText(std::ostream& out);
+};
+
+// Счётчики одной очереди. Обновляются только владельцем очереди, читаются
+// снимком из любого потока, поэтому достаточно relaxed-атомиков. Текущий размер
+// не хранится, а выводится из разности счётчиков.
+class QueueProbeBase {
+protected:
+    // Пишет только владелец очереди, поэтому обходимся без атомарного сложения
+    static void bump(std::atomic<uint64_t>& counter, uint64_t delta) {
+        counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+
+    std::string name;
+    std::atomic<uint64_t> enqueues;
+    std::atomic<uint64_t> dequeues;
+    std::atomic<uint64_t> failedDequeues;
+    std::atomic<uint64_t> peakSize;
+    std::mutex histogramLock;
+    LatencyHistogram waitTicks;
+
+public:
+    explicit QueueProbeBase(const std::string& queueName)
+        : name(queueName), enqueues(0), dequeues(0), failedDequeues(0), peakSize(0) {
+        QueueRegistry::instance().add(this);
+    }
+
+    QueueProbeBase(const QueueProbeBase&) = delete;
+    QueueProbeBase& operator=(const QueueProbeBase&) = delete;
+
+    ~QueueProbeBase() {
+        QueueRegistry::instance().remove(this);
+    }
+
+    QueueStats stats() {
+        QueueStats result;
+        result.name = name;
+        // Счётчики публикуются независимо, поэтому размер на всякий случай ограничен снизу
+        result.dequeues = dequeues.load(std::memory_order_relaxed);
+        result.enqueues = enqueues.load(std::memory_order_relaxed);
+        result.failedDequeues = failedDequeues.load(std::memory_order_relaxed);
+        result.size = result.enqueues > result.dequeues ? result.enqueues - result.dequeues : 0;
+        result.peakSize = peakSize.load(std::memory_order_relaxed);
+        std::lock_guard<std::mutex> guard(histogramLock);
+        result.waitTicks = waitTicks;
+        return result;
+    }
+};
+
+inline std::vector<QueueStats> QueueRegistry::snapshot() {
+    std::lock_guard<std::mutex> guard(lock);
+    std::vector<QueueStats> result;
+    result.reserve(probes.size());
+    for (QueueProbeBase* probe : probes)
+        result.push_back(probe->stats());
+    return result;
+}
+
+inline void QueueRegistry::exportText(std::ostream& out) {
+    for (const QueueStats& stats : snapshot()) {
+        out << stats.name << ": enqueues=" << stats.enqueues << " dequeues=" << stats.dequeues
+            << " failed=" << stats.failedDequeues << " size=" << stats.size
+            << " peak=" << stats.peakSize;
+        if (stats.waitTicks.count()) {
+            out << " wait_p50=" << stats.waitTicks.percentile(0.5)
+                << " wait_p99=" << stats.waitTicks.percentile(0.99);
+        }
+        out << std::endl;
+    }
+}
+
+// Включённое инструментирование: счётчики и задержка от постановки до извлечения
+// для каждого SampleEvery-го элемента по меткам времени TSC. Хранятся только
+// выбранные элементы: их порядковый номер и метка; элемент извлечён, когда счётчик
+// извлечений перешёл его номер. Обычная операция лишь увеличивает счётчик владельца;
+// общие счётчики публикуются на выбранных элементах и когда очередь опустевает, пик
+// замеряется только на выбранных элементах, а замеры задержки уходят в гистограмму
+// пачками по 32. Поэтому снимок может отставать на SampleEvery операций и 32 замера.
+template <unsigned SampleEvery = 64>
+struct QueueInstrumentation {
+    class Probe : public QueueProbeBase {
+    private:
+        struct Sample {
+            uint64_t position;
+            uint64_t stamp;
+        };
+
+        SegmentedStorage<Sample> samples;
+        uint64_t enqueuedTotal;
+        uint64_t dequeuedTotal;
+        uint64_t nextSample;        // номер следующего выбираемого элемента
+        uint64_t nextCheckpoint;    // счётчик извлечений, на котором снова нужен медленный путь
+        uint64_t peak;
+        // Замеры копятся здесь и переносятся в общую гистограмму под блокировкой пачками
+        std::array<uint64_t, 32> pendingWaits;
+        size_t pendingCount;
+
+        void publish() {
+            enqueues.store(enqueuedTotal, std::memory_order_relaxed);
+            dequeues.store(dequeuedTotal, std::memory_order_relaxed);
+        }
+
+        void flushWaits() {
+            std::lock_guard<std::mutex> guard(histogramLock);
+            for (size_t i = 0; i < pendingCount; i++)
+                waitTicks.record(pendingWaits[i]);
+            pendingCount = 0;
+        }
+
+        void sampleEnqueued(size_t sizeAfter) {
+            uint64_t stamp = readTimestamp();
+            if (samples.empty())
+                nextCheckpoint = std::min(nextCheckpoint, nextSample + 1);
+            for (; nextSample < enqueuedTotal; nextSample += SampleEvery)
+                samples.push_back(Sample{nextSample, stamp});
+            if (sizeAfter > peak) {
+                peak = sizeAfter;
+                peakSize.store(peak, std::memory_order_relaxed);
+            }
+            publish();
+        }
+
+        void checkpoint(size_t sizeAfter) {
+            if (!samples.empty() && samples.front().position < dequeuedTotal) {
+                uint64_t now = readTimestamp();
+                while (!samples.empty() && samples.front().position < dequeuedTotal) {
+                    pendingWaits[pendingCount++] = now - samples.front().stamp;
+                    samples.pop_front();
+                    if (pendingCount == pendingWaits.size())
+                        flushWaits();
+                }
+            }
+            // Опустевшая очередь сбрасывает всё, чтобы снимок простаивающей очереди был полным
+            if (sizeAfter == 0 && pendingCount > 0)
+                flushWaits();
+            nextCheckpoint = samples.empty() ? dequeuedTotal + SampleEvery
+                                             : std::min(samples.front().position + 1, dequeuedTotal + SampleEvery);
+            publish();
+        }
+
+    public:
+        explicit Probe(const std::string& queueName)
+            : QueueProbeBase(queueName), enqueuedTotal(0), dequeuedTotal(0),
+              nextSample(SampleEvery - 1), nextCheckpoint(SampleEvery), peak(0), pendingCount(0) {}
+
+        ~Probe() {
+            flushWaits();
+        }
+
+        void enqueued(size_t count, size_t sizeAfter) {
+            enqueuedTotal += count;
+            if (enqueuedTotal > nextSample)
+                sampleEnqueued(sizeAfter);
+        }
+
+        void dequeued(size_t count, size_t sizeAfter) {
+            dequeuedTotal += count;
+            if (dequeuedTotal >= nextCheckpoint || sizeAfter == 0)
+                checkpoint(sizeAfter);
+        }
+
+        void failedDequeue() {
+            bump(failedDequeues, 1);
+        }
+    };
+};
+
+template <typename T, typename Policy = NoInstrumentation>
+class CommonQueue {
+protected:
+    SegmentedStorage<T> items;
+    [[no_unique_address]] typename Policy::Probe probe;
+
+    void clear() {
+        size_t n = items.size();
+        items.clear();
+        probe.dequeued(n, 0);
+    }
+
+public:
+    explicit CommonQueue(const std::string& name = "queue") : probe(name) {}
+    virtual ~CommonQueue() {}
+
+    void enqueue(const T& value) {
+        items.push_back(value);
+        probe.enqueued(1, items.size());
+    }
+
+    void enqueue(T&& value) {
+        items.push_back(std::move(value));
+        probe.enqueued(1, items.size());
+    }
+
+    template <typename... Args>
+    T& emplace(Args&&... args) {
+        T& value = items.emplace_back(std::forward<Args>(args)...);
+        probe.enqueued(1, items.size());
+        return value;
+    }
+
+    template <typename InputIt>
+    size_t enqueue_range(InputIt first, InputIt last) {
+        size_t added = items.append(first, last);
+        probe.enqueued(added, items.size());
+        return added;
+    }
+
+    bool dequeue(T& value) {
+        if (items.empty()) {
+            probe.failedDequeue();
+            return false;
+        }
+        value = std::move(items.front());
+        items.pop_front();
+        probe.dequeued(1, items.size());
+        return true;
+    }
+
+    template <typename OutputIt>
+    size_t dequeue_n(OutputIt out, size_t n) {
+        size_t taken = items.take(n, out);
+        if (taken == 0 && n > 0)
+            probe.failedDequeue();
+        probe.dequeued(taken, items.size());
+        return taken;
+    }
+
+    size_t size() const { 
+        return items.size(); 
+    }
+};
+
+// Моноиды для AggregatingQueue. Моноид задаёт value_type, identity(), lift(x)
+// и ассоциативную combine(a, b). Флаг commutative разрешает свёртку в несколько
+// независимых потоков, а invertible - поддержку агрегата вычитанием
+// uncombine(total, removed) вместо двух стеков.
+template <typename T, typename Acc = long long>
+struct SumMonoid {
+    using value_type = Acc;
+    static constexpr bool commutative = true;
+    static constexpr bool invertible = true;
+    static value_type identity() { return Acc(); }
+    static value_type lift(const T& value) { return Acc(value); }
+    static value_type combine(const value_type& a, const value_type& b) { return a + b; }
+    static value_type uncombine(const value_type& total, const value_type& removed) { return total - removed; }
+};
+
+template <typename T>
+struct CountMonoid {
+    using value_type = size_t;
+    static constexpr bool commutative = true;
+    static constexpr bool invertible = true;
+    static value_type identity() { return 0; }
+    static value_type lift(const T&) { return 1; }
+    static value_type combine(value_type a, value_type b) { return a + b; }
+    static value_type uncombine(value_type total, value_type removed) { return total - removed; }
+};
+
+template <typename T>
+struct MinMonoid {
+    using value_type = T;
+    static constexpr bool commutative = true;
+    static constexpr bool invertible = false;
+    static value_type identity() { return std::numeric_limits<T>::max(); }
+    static value_type lift(const T& value) { return value; }
+    static value_type combine(const value_type& a, const value_type& b) { return b < a ? b : a; }
+};
+
+template <typename T>
+struct MaxMonoid {
+    using value_type = T;
+    static constexpr bool commutative = true;
+    static constexpr bool invertible = false;
+    static value_type identity() { return std::numeric_limits<T>::lowest(); }
+    static value_type lift(const T& value) { return value; }
+    static value_type combine(const value_type& a, const value_type& b) { return a < b ? b : a; }
+};
+
+// Свёртка непрерывного участка. Для коммутативных моноидов ведётся в четыре
+// независимых аккумулятора, чтобы компилятор мог векторизовать цикл.
+template <typename Monoid, typename T>
+typename Monoid::value_type reduceSpan(const T* data, size_t length) {
+    using Value = typename Monoid::value_type;
+    size_t i = 0;
+    if constexpr (Monoid::commutative) {
+        Value lanes[4] = {Monoid::identity(), Monoid::identity(), Monoid::identity(), Monoid::identity()};
+        for (; i + 4 <= length; i += 4) {
+            for (size_t k = 0; k < 4; k++)
+                lanes[k] = Monoid::combine(lanes[k], Monoid::lift(data[i + k]));
+        }
+        for (; i < length; i++)
+            lanes[0] = Monoid::combine(lanes[0], Monoid::lift(data[i]));
+        return Monoid::combine(Monoid::combine(lanes[0], lanes[1]), Monoid::combine(lanes[2], lanes[3]));
+    } else {
+        Value total = Monoid::identity();
+        for (; i < length; i++)
+            total = Monoid::combine(total, Monoid::lift(data[i]));
+        return total;
+    }
+}
+
+// Очередь с агрегатом по всем элементам за O(1). Необратимые агрегаты (min, max)
+// считаются по схеме двух стеков: у "передней" части хранятся суффиксные агрегаты,
+// у "задней" - один накопленный, при опустошении передней части задняя переворачивается.
+// Наследование защищённое: вставка и извлечение в обход агрегата невозможны.
+template <typename T, typename Monoid, typename Policy = NoInstrumentation>
+class AggregatingQueue : protected CommonQueue<T, Policy> {
+public:
+    using value_type = typename Monoid::value_type;
+    using CommonQueue<T, Policy>::size;
+
+private:
+    value_type backTotal;
+    std::vector<value_type> frontTotals;
+
+    void pushed(const T& value) {
+        backTotal = Monoid::combine(backTotal, Monoid::lift(value));
+        this->probe.enqueued(1, this->items.size());
+    }
+
+    void flip() {
+        size_t n = this->items.size();
+        frontTotals.resize(n);
+        size_t k = n;
+        this->items.forEachSpan([&](const T* data, size_t length) {
+            for (size_t i = 0; i < length; i++)
+                frontTotals[--k] = Monoid::lift(data[i]);
+        });
+        for (k = 1; k < n; k++)
+            frontTotals[k] = Monoid::combine(frontTotals[k], frontTotals[k - 1]);
+        backTotal = Monoid::identity();
+    }
+
+    void popping(const T& value) {
+        if constexpr (Monoid::invertible) {
+            backTotal = Monoid::uncombine(backTotal, Monoid::lift(value));
+        } else {
+            if (frontTotals.empty())
+                flip();
+            frontTotals.pop_back();
+        }
+    }
+
+public:
+    explicit AggregatingQueue(const std::string& name = "queue")
+        : CommonQueue<T, Policy>(name), backTotal(Monoid::identity()) {}
+
+    void enqueue(const T& value) {
+        pushed(this->items.emplace_back(value));
+    }
+
+    void enqueue(T&& value) {
+        pushed(this->items.emplace_back(std::move(value)));
+    }
+
+    template <typename... Args>
+    T& emplace(Args&&... args) {
+        T& value = this->items.emplace_back(std::forward<Args>(args)...);
+        pushed(value);
+        return value;
+    }
+
+    template <typename InputIt>
+    size_t enqueue_range(InputIt first, InputIt last) {
+        size_t added = this->items.append(first, last, [this](const T* data, size_t length) {
+            backTotal = Monoid::combine(backTotal, reduceSpan<Monoid>(data, length));
+        });
+        this->probe.enqueued(added, this->items.size());
+        return added;
+    }
+
+    bool dequeue(T& value) {
+        if (this->items.empty()) {
+            this->probe.failedDequeue();
+            return false;
+        }
+        popping(this->items.front());
+        value = std::move(this->items.front());
+        this->items.pop_front();
+        this->probe.dequeued(1, this->items.size());
+        return true;
+    }
+
+    template <typename OutputIt>
+    size_t dequeue_n(OutputIt out, size_t n) {
+        if (n > 0 && this->items.empty())
+            this->probe.failedDequeue();
+        n = std::min(n, this->items.size());
+        if (n == 0)
+            return 0;
+        size_t taken;
+        if constexpr (Monoid::invertible) {
+            value_type removed = Monoid::identity();
+            this->items.forEachSpan([&removed](const T* data, size_t length) {
+                removed = Monoid::combine(removed, reduceSpan<Monoid>(data, length));
+            }, n);
+            backTotal = Monoid::uncombine(backTotal, removed);
+            taken = this->items.take(n, out);
+        } else {
+            taken = this->items.take(n, out);
+            if (taken <= frontTotals.size()) {
+                frontTotals.resize(frontTotals.size() - taken);
+            } else {
+                // Передняя часть исчерпана, остаток целиком из задней
+                frontTotals.clear();
+                flip();
+            }
+        }
+        this->probe.dequeued(taken, this->items.size());
+        return taken;
+    }
+
+    value_type aggregate() const {
+        if constexpr (Monoid::invertible) {
+            return backTotal;
+        } else {
+            if (frontTotals.empty())
+                return backTotal;
+            return Monoid::combine(frontTotals.back(), backTotal);
+        }
+    }
+
+    void clear() {
+        CommonQueue<T, Policy>::clear();
+        frontTotals.clear();
+        backTotal = Monoid::identity();
+    }
+};
+
+template <typename T, typename Policy = NoInstrumentation>
+class Queue : public CommonQueue<T, Policy> {
+public:
+    using CommonQueue<T, Policy>::CommonQueue;
+
+    Queue& operator<<(const T& value) {
+        this->enqueue(value);
+        return *this;
+    }
+
+    Queue& operator<<(T&& value) {
+        this->enqueue(std::move(value));
+        return *this;
+    }
+};
+
+template <typename Policy>
+class Queue<int, Policy> : public AggregatingQueue<int, SumMonoid<int>, Policy> {
+public:
+    using AggregatingQueue<int, SumMonoid<int>, Policy>::AggregatingQueue;
+
+    long long sum() const {
+        return this->aggregate();
+    }
+
+    Queue& operator<<(const int& value) {
+        this->enqueue(value);
+        return *this;
+    }
+};
+
+template <typename Policy>
+class Queue<char, Policy> : public CommonQueue<char, Policy> {
+public:
+    explicit Queue(size_t size = 100, const std::string& name = "queue")
+        : CommonQueue<char, Policy>(name) {
+        this->items.reserve(size);
+    }
+
+    Queue& operator<<(char value) {
+        this->enqueue(value);
+        return *this;
+    }
+};
+
+// Байтовый канал для одного писателя и одного читателя без блокировок.
+// Позиции растут монотонно, ёмкость - степень двойки, поэтому индекс в буфере
+// берётся маской. Каждая сторона держит кэшированную копию чужой позиции и
+// перечитывает её только когда кажется, что места или данных не хватает.
+class SpscByteQueue {
+private:
+    static constexpr size_t CacheLine = 64;
+
+    char* data;
+    size_t capacity;
+    size_t mask;
+
+    alignas(CacheLine) std::atomic<size_t> head;
+    size_t cachedTail;
+
+    alignas(CacheLine) std::atomic<size_t> tail;
+    size_t cachedHead;
+
+    static size_t roundUp(size_t n) {
+        size_t result = 1;
+        while (result < n)
+            result <<= 1;
+        return result;
+    }
+
+public:
+    explicit SpscByteQueue(size_t minCapacity = 1 << 16)
+        : capacity(roundUp(std::max<size_t>(minCapacity, 2))), mask(capacity - 1),
+          head(0), cachedTail(0), tail(0), cachedHead(0) {
+        data = new char[capacity];
+    }
+
+    SpscByteQueue(const SpscByteQueue&) = delete;
+    SpscByteQueue& operator=(const SpscByteQueue&) = delete;
+
+    ~SpscByteQueue() {
+        delete[] data;
+    }
+
+    // Сторона писателя
+
+    // Непрерывный свободный участок до конца буфера для заполнения на месте
+    std::span<char> reserve(size_t maxBytes = SIZE_MAX) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (capacity - (t - cachedHead) < std::min(maxBytes, capacity))
+            cachedHead = head.load(std::memory_order_acquire);
+        size_t available = capacity - (t - cachedHead);
+        size_t offset = t & mask;
+        size_t length = std::min({available, capacity - offset, maxBytes});
+        return std::span<char>(data + offset, length);
+    }
+
+    void commit(size_t bytes) {
+        tail.store(tail.load(std::memory_order_relaxed) + bytes, std::memory_order_release);
+    }
+
+    size_t write(std::span<const char> bytes) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (capacity - (t - cachedHead) < bytes.size())
+            cachedHead = head.load(std::memory_order_acquire);
+        size_t length = std::min(bytes.size(), capacity - (t - cachedHead));
+        size_t offset = t & mask;
+        size_t first = std::min(length, capacity - offset);
+        std::memcpy(data + offset, bytes.data(), first);
+        std::memcpy(data, bytes.data() + first, length - first);
+        tail.store(t + length, std::memory_order_release);
+        return length;
+    }
+
+    // Сторона читателя
+
+    // Непрерывный участок готовых данных до конца буфера
+    std::span<const char> peek() {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (cachedTail == h)
+            cachedTail = tail.load(std::memory_order_acquire);
+        size_t offset = h & mask;
+        size_t length = std::min(cachedTail - h, capacity - offset);
+        return std::span<const char>(data + offset, length);
+    }
+
+    void consume(size_t bytes) {
+        head.store(head.load(std::memory_order_relaxed) + bytes, std::memory_order_release);
+    }
+
+    size_t read(std::span<char> out) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (cachedTail - h < out.size())
+            cachedTail = tail.load(std::memory_order_acquire);
+        size_t length = std::min(out.size(), cachedTail - h);
+        size_t offset = h & mask;
+        size_t first = std::min(length, capacity - offset);
+        std::memcpy(out.data(), data + offset, first);
+        std::memcpy(out.data() + first, data, length - first);
+        head.store(h + length, std::memory_order_release);
+        return length;
+    }
+
+    size_t size() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    size_t getCapacity() const {
+        return capacity;
+    }
+};
+
+// Строки хранятся подряд в байтовых кусках арены с префиксом длины.
+// Прочитанные куски возвращаются целиком при следующем извлечении.
+template <typename Policy>
+class Queue<const char*, Policy> {
+private:
+    static constexpr size_t ChunkSize = 64 * 1024;
+
+    struct Chunk {
+        char* data;
+        size_t capacity;
+        size_t used;
+        size_t read;
+        Chunk* next;
+
+        explicit Chunk(size_t size)
+            : data(new char[size]), capacity(size), used(0), read(0), next(nullptr) {}
+        ~Chunk() { 
+            delete[] data; 
+        }
+    };
+    Chunk* front;
+    Chunk* rear;
+    Chunk* spare;
+    size_t count;
+    [[no_unique_address]] typename Policy::Probe probe;
+
+    Chunk* acquireChunk(size_t needed) {
+        if (spare && spare->capacity >= needed) {
+            Chunk* chunk = spare;
+            spare = nullptr;
+            return chunk;
+        }
+        return new Chunk(std::max(ChunkSize, needed));
+    }
+
+    void releaseChunk(Chunk* chunk) {
+        chunk->used = chunk->read = 0;
+        chunk->next = nullptr;
+        if (spare && spare->capacity >= chunk->capacity) {
+            delete chunk;
+            return;
+        }
+        delete spare;
+        spare = chunk;
+    }
+
+    // Освобождает куски, которые потребитель уже полностью прочитал
+    void reclaim() {
+        while (front && front->read == front->used) {
+            if (front == rear) {
+                front->used = front->read = 0;
+                break;
+            }
+            Chunk* temp = front;
+            front = front->next;
+            releaseChunk(temp);
+        }
+    }
+
+public:
+    explicit Queue(const std::string& name = "queue")
+        : front(nullptr), rear(nullptr), spare(nullptr), count(0), probe(name) {}
+    Queue(const Queue&) = delete;
+    Queue& operator=(const Queue&) = delete;
+    ~Queue() {
+        while (front) {
+            Chunk* temp = front;
+            front = front->next;
+            delete temp;
+        }
+        delete spare;
+    }
+
+    void enqueue(std::string_view value) {
+        size_t length = value.size();
+        size_t needed = sizeof(length) + length;
+        if (!rear || rear->capacity - rear->used < needed) {
+            Chunk* chunk = acquireChunk(needed);
+            if (!rear) {
+                front = rear = chunk;
+            } else {
+                rear->next = chunk;
+                rear = chunk;
+            }
+        }
+        char* place = rear->data + rear->used;
+        std::memcpy(place, &length, sizeof(length));
+        std::memcpy(place + sizeof(length), value.data(), length);
+        rear->used += needed;
+        count++;
+        probe.enqueued(1, count);
+    }
+
+    void enqueue(const char* value) {
+        enqueue(std::string_view(value));
+    }
+
+    // Строка остаётся действительной до следующего вызова dequeue
+    bool dequeue(std::string_view& output) {
+        reclaim();
+        if (count == 0) {
+            probe.failedDequeue();
+            return false;
+        }
+        size_t length;
+        const char* place = front->data + front->read;
+        std::memcpy(&length, place, sizeof(length));
+        output = std::string_view(place + sizeof(length), length);
+        front->read += sizeof(length) + length;
+        count--;
+        probe.dequeued(1, count);
+        return true;
+    }
+
+    // Копирует строку с завершающим нулём в буфер вызывающего. Если буфер
+    // мал, строка остаётся в очереди, а в length возвращается её длина.
+    bool dequeue(char* buffer, size_t capacity, size_t& length) {
+        reclaim();
+        length = 0;
+        if (count == 0) {
+            probe.failedDequeue();
+            return false;
+        }
+        const char* place = front->data + front->read;
+        std::memcpy(&length, place, sizeof(length));
+        if (length >= capacity) 
+            return false;
+        std::memcpy(buffer, place + sizeof(length), length);
+        buffer[length] = '\0';
+        front->read += sizeof(length) + length;
+        count--;
+        probe.dequeued(1, count);
+        return true;
+    }
+
+    bool dequeue(char*& output) {
+        std::string_view view;
+        if (!dequeue(view)) 
+            return false;
+        output = new char[view.size() + 1];
+        std::memcpy(output, view.data(), view.size());
+        output[view.size()] = '\0';
+        return true;
+    }
+
+    Queue& operator<<(const char* value) {
+        enqueue(value);
+        return *this;
+    }
+
+    size_t size() const { 
+        return count; 
+    }
+};
+
+// Кодек для выгрузки элементов на диск. Для других типов нужно определить
+// специализацию с encode(std::vector<char>&, const T&) и decode(const char*&).
+template <typename T, typename Enable = void>
+struct SpillCodec;
+
+template <typename T>
+struct SpillCodec<T, std::enable_if_t<std::is_trivially_copyable_v<T>>> {
+    static void encode(std::vector<char>& out, const T& value) {
+        const char* bytes = reinterpret_cast<const char*>(&value);
+        out.insert(out.end(), bytes, bytes + sizeof(T));
+    }
+
+    static T decode(const char*& in) {
+        T value;
+        std::memcpy(&value, in, sizeof(T));
+        in += sizeof(T);
+        return value;
+    }
+};
+
+template <>
+struct SpillCodec<std::string> {
+    static void encode(std::vector<char>& out, const std::string& value) {
+        size_t length = value.size();
+        const char* prefix = reinterpret_cast<const char*>(&length);
+        out.insert(out.end(), prefix, prefix + sizeof(length));
+        out.insert(out.end(), value.begin(), value.end());
+    }
+
+    static std::string decode(const char*& in) {
+        size_t length;
+        std::memcpy(&length, in, sizeof(length));
+        in += sizeof(length);
+        std::string value(in, length);
+        in += length;
+        return value;
+    }
+};
+
+// Очередь с ограниченным расходом памяти. Пока в памяти меньше highWaterMark
+// элементов, она ведёт себя как CommonQueue; дальше новые элементы копятся
+// пакетами по segmentSize и выгружаются в файлы сегментов, которые читаются
+// обратно по мере опустошения головы очереди. Базовая очередь хранит только голову,
+// поэтому наследование защищённое и все операции идут через push() и refill().
+template <typename T, typename Codec = SpillCodec<T>>
+class SpillingQueue : protected CommonQueue<T> {
+private:
+    struct Segment {
+        std::string path;
+        size_t count;
+        size_t bytes;
+    };
+
+    static constexpr bool RawLayout =
+        std::is_trivially_copyable_v<T> && std::is_same_v<Codec, SpillCodec<T>>;
+
+    size_t highWaterMark;
+    size_t segmentSize;
+    std::filesystem::path directory;
+    SegmentedStorage<T> pending;
+    SegmentedStorage<Segment> segments;
+    size_t spilledCount;
+
+    static std::string nextSegmentName() {
+        static std::atomic<unsigned long> sequence(0);
+        return "queue-spill-" + std::to_string(currentProcessId()) + "-" +
+               std::to_string(sequence.fetch_add(1)) + ".seg";
+    }
+
+    static long currentProcessId() {
+#if defined(__unix__) || defined(__APPLE__)
+        return static_cast<long>(::getpid());
+#else
+        return 0;
+#endif
+    }
+
+    template <typename Fill>
+    static void writeSegmentFile(const std::string& path, size_t bytes, Fill&& fill) {
+#if defined(__unix__) || defined(__APPLE__)
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+        if (fd < 0) 
+            throw std::runtime_error("Cannot create spill segment " + path);
+        if (bytes > 0) {
+            if (::ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+                ::close(fd);
+                throw std::runtime_error("Cannot resize spill segment " + path);
+            }
+            void* map = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (map == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("Cannot map spill segment " + path);
+            }
+            try {
+                fill(static_cast<char*>(map));
+            } catch (...) {
+                ::munmap(map, bytes);
+                ::close(fd);
+                throw;
+            }
+            ::munmap(map, bytes);
+        }
+        ::close(fd);
+#else
+        std::vector<char> buffer(bytes);
+        fill(buffer.data());
+        std::ofstream out(path, std::ios::binary);
+        if (!out.write(buffer.data(), bytes)) 
+            throw std::runtime_error("Cannot write spill segment " + path);
+#endif
+    }
+
+    template <typename Consume>
+    static void readSegmentFile(const std::string& path, size_t bytes, Consume&& consume) {
+        if (bytes == 0) {
+            consume(static_cast<const char*>(nullptr));
+            return;
+        }
+#if defined(__unix__) || defined(__APPLE__)
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) 
+            throw std::runtime_error("Cannot open spill segment " + path);
+        void* map = ::mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED) 
+            throw std::runtime_error("Cannot map spill segment " + path);
+        ::madvise(map, bytes, MADV_SEQUENTIAL);
+        try {
+            consume(static_cast<const char*>(map));
+        } catch (...) {
+            ::munmap(map, bytes);
+            throw;
+        }
+        ::munmap(map, bytes);
+#else
+        std::vector<char> buffer(bytes);
+        std::ifstream in(path, std::ios::binary);
+        if (!in.read(buffer.data(), bytes)) 
+            throw std::runtime_error("Cannot read spill segment " + path);
+        consume(static_cast<const char*>(buffer.data()));
+#endif
+    }
+
+    // При ошибке записи недописанный файл удаляется, а элементы остаются в pending
+    void spill() {
+        Segment segment;
+        segment.path = (directory / nextSegmentName()).string();
+        segment.count = pending.size();
+        try {
+            writeSegment(segment);
+        } catch (...) {
+            std::error_code ignored;
+            std::filesystem::remove(segment.path, ignored);
+            throw;
+        }
+        pending.clear();
+        spilledCount += segment.count;
+        segments.push_back(std::move(segment));
+    }
+
+    void writeSegment(Segment& segment) {
+        if constexpr (RawLayout) {
+            segment.bytes = segment.count * sizeof(T);
+            writeSegmentFile(segment.path, segment.bytes, [this](char* out) {
+                pending.forEachSpan([&out](const T* data, size_t length) {
+                    std::memcpy(out, data, length * sizeof(T));
+                    out += length * sizeof(T);
+                });
+            });
+        } else {
+            std::vector<char> buffer;
+            pending.forEachSpan([&buffer](const T* data, size_t length) {
+                for (size_t i = 0; i < length; i++)
+                    Codec::encode(buffer, data[i]);
+            });
+            segment.bytes = buffer.size();
+            writeSegmentFile(segment.path, segment.bytes, [&buffer](char* out) {
+                std::memcpy(out, buffer.data(), buffer.size());
+            });
+        }
+    }
+
+    // Голова опустела: подгружаем следующий сегмент или хвост из памяти. Сегмент
+    // снимается с очереди только после успешного чтения; при ошибке голова
+    // остаётся пустой, и следующая попытка прочитает тот же сегмент.
+    void refill() {
+        if (!segments.empty()) {
+            const Segment& segment = segments.front();
+            try {
+                readSegmentFile(segment.path, segment.bytes, [this, &segment](const char* in) {
+                    if constexpr (RawLayout) {
+                        const T* first = reinterpret_cast<const T*>(in);
+                        this->items.append(first, first + segment.count);
+                    } else {
+                        for (size_t i = 0; i < segment.count; i++)
+                            this->items.emplace_back(Codec::decode(in));
+                    }
+                });
+            } catch (...) {
+                this->items.clear();
+                throw;
+            }
+            std::error_code ignored;
+            std::filesystem::remove(segment.path, ignored);
+            spilledCount -= segment.count;
+            segments.pop_front();
+        } else {
+            this->items.swap(pending);
+        }
+    }
+
+    template <typename U>
+    void push(U&& value) {
+        if (segments.empty() && pending.empty() && this->items.size() < highWaterMark) {
+            this->items.emplace_back(std::forward<U>(value));
+            return;
+        }
+        pending.emplace_back(std::forward<U>(value));
+        if (pending.size() >= segmentSize)
+            spill();
+    }
+
+public:
+    explicit SpillingQueue(size_t maxInMemory, size_t elementsPerSegment = 4096,
+                           const std::filesystem::path& spillDirectory = std::filesystem::temp_directory_path())
+        : highWaterMark(std::max<size_t>(maxInMemory, 1)),
+          segmentSize(std::max<size_t>(elementsPerSegment, 1)),
+          directory(spillDirectory), spilledCount(0) {}
+
+    ~SpillingQueue() {
+        segments.forEachSpan([](const Segment* data, size_t length) {
+            for (size_t i = 0; i < length; i++) {
+                std::error_code ignored;
+                std::filesystem::remove(data[i].path, ignored);
+            }
+        });
+    }
+
+    void enqueue(const T& value) {
+        push(value);
+    }
+
+    void enqueue(T&& value) {
+        push(std::move(value));
+    }
+
+    // Элемент может сразу уйти на диск, поэтому ссылка на него не возвращается
+    template <typename... Args>
+    void emplace(Args&&... args) {
+        push(T(std::forward<Args>(args)...));
+    }
+
+    template <typename InputIt>
+    size_t enqueue_range(InputIt first, InputIt last) {
+        size_t added = 0;
+        for (; first != last; ++first, ++added)
+            push(*first);
+        return added;
+    }
+
+    bool dequeue(T& value) {
+        if (this->items.empty())
+            refill();
+        return CommonQueue<T>::dequeue(value);
+    }
+
+    template <typename OutputIt>
+    size_t dequeue_n(OutputIt out, size_t n) {
+        size_t taken = 0;
+        while (taken < n) {
+            if (this->items.empty())
+                refill();
+            if (this->items.empty())
+                break;
+            taken += this->items.take(n - taken, out);
+        }
+        return taken;
+    }
+
+    SpillingQueue& operator<<(const T& value) {
+        push(value);
+        return *this;
+    }
+
+    SpillingQueue& operator<<(T&& value) {
+        push(std::move(value));
+        return *this;
+    }
+
+    size_t size() const {
+        return this->items.size() + spilledCount + pending.size();
+    }
+
+    size_t spilled() const {
+        return spilledCount;
+    }
+};
+
+// Очередь с приоритетами на неявной 4-арной куче: у узла четыре соседних потомка,
+// поэтому куча мельче двоичной, а сравнения при просеивании идут по одной-двум
+// кэш-линиям. Первым извлекается наименьший по Compare элемент. Отмена по дескриптору
+// только помечает элемент; помеченные пропускаются при извлечении, а когда их
+// становится больше половины, куча перестраивается за O(n).
+template <typename T, typename Compare = std::less<T>>
+class PriorityQueue {
+public:
+    struct Handle {
+        uint32_t index = UINT32_MAX;
+        uint32_t generation = 0;
+    };
+
+private:
+    struct Node {
+        T value;
+        uint32_t slot;
+    };
+
+    struct Slot {
+        uint32_t generation = 0;
+        bool cancelled = false;
+    };
+
+    std::vector<Node> heap;
+    std::vector<Slot> slots;
+    std::vector<uint32_t> freeSlots;
+    size_t cancelledCount = 0;
+    [[no_unique_address]] Compare comp;
+
+    uint32_t allocateSlot() {
+        if (!freeSlots.empty()) {
+            uint32_t slot = freeSlots.back();
+            freeSlots.pop_back();
+            return slot;
+        }
+        slots.emplace_back();
+        return static_cast<uint32_t>(slots.size() - 1);
+    }
+
+    void releaseSlot(uint32_t slot) {
+        slots[slot].generation++;
+        slots[slot].cancelled = false;
+        freeSlots.push_back(slot);
+    }
+
+    void siftUp(size_t i) {
+        Node node = std::move(heap[i]);
+        while (i > 0) {
+            size_t parent = (i - 1) / 4;
+            if (!comp(node.value, heap[parent].value))
+                break;
+            heap[i] = std::move(heap[parent]);
+            i = parent;
+        }
+        heap[i] = std::move(node);
+    }
+
+    void siftDown(size_t i) {
+        size_t n = heap.size();
+        Node node = std::move(heap[i]);
+        while (true) {
+            size_t first = 4 * i + 1;
+            if (first >= n)
+                break;
+            size_t best = first;
+            size_t last = std::min(first + 4, n);
+            for (size_t child = first + 1; child < last; child++) {
+                if (comp(heap[child].value, heap[best].value))
+                    best = child;
+            }
+            if (!comp(heap[best].value, node.value))
+                break;
+            heap[i] = std::move(heap[best]);
+            i = best;
+        }
+        heap[i] = std::move(node);
+    }
+
+    void popTop() {
+        releaseSlot(heap.front().slot);
+        if (heap.size() > 1)
+            heap.front() = std::move(heap.back());
+        heap.pop_back();
+        if (!heap.empty())
+            siftDown(0);
+    }
+
+    void skipCancelled() {
+        while (!heap.empty() && slots[heap.front().slot].cancelled) {
+            cancelledCount--;
+            popTop();
+        }
+    }
+
+    void compact() {
+        size_t kept = 0;
+        for (size_t i = 0; i < heap.size(); i++) {
+            if (slots[heap[i].slot].cancelled) {
+                releaseSlot(heap[i].slot);
+            } else {
+                if (kept != i)
+                    heap[kept] = std::move(heap[i]);
+                kept++;
+            }
+        }
+        heap.erase(heap.begin() + kept, heap.end());
+        cancelledCount = 0;
+        for (size_t i = heap.size() / 4 + 1; i-- > 0;) {
+            if (i < heap.size())
+                siftDown(i);
+        }
+    }
+
+public:
+    explicit PriorityQueue(const Compare& compare = Compare()) : comp(compare) {}
+
+    Handle enqueue(const T& value) {
+        return emplace(value);
+    }
+
+    Handle enqueue(T&& value) {
+        return emplace(std::move(value));
+    }
+
+    template <typename... Args>
+    Handle emplace(Args&&... args) {
+        uint32_t slot = allocateSlot();
+        heap.push_back(Node{T(std::forward<Args>(args)...), slot});
+        siftUp(heap.size() - 1);
+        return Handle{slot, slots[slot].generation};
+    }
+
+    PriorityQueue& operator<<(const T& value) {
+        enqueue(value);
+        return *this;
+    }
+
+    PriorityQueue& operator<<(T&& value) {
+        enqueue(std::move(value));
+        return *this;
+    }
+
+    // Возвращает false, если элемент уже извлечён или отменён
+    bool cancel(Handle handle) {
+        if (handle.index >= slots.size())
+            return false;
+        Slot& slot = slots[handle.index];
+        if (slot.generation != handle.generation || slot.cancelled)
+            return false;
+        slot.cancelled = true;
+        cancelledCount++;
+        if (cancelledCount * 2 > heap.size())
+            compact();
+        return true;
+    }
+
+    const T* top() {
+        skipCancelled();
+        return heap.empty() ? nullptr : &heap.front().value;
+    }
+
+    bool dequeue(T& value) {
+        skipCancelled();
+        if (heap.empty())
+            return false;
+        value = std::move(heap.front().value);
+        popTop();
+        return true;
+    }
+
+    // Извлекает по порядку все элементы, не превосходящие bound
+    template <typename OutputIt>
+    size_t dequeue_until(const T& bound, OutputIt out) {
+        size_t taken = 0;
+        while (true) {
+            skipCancelled();
+            if (heap.empty() || comp(bound, heap.front().value))
+                break;
+            *out = std::move(heap.front().value);
+            ++out;
+            popTop();
+            taken++;
+        }
+        return taken;
+    }
+
+    size_t size() const {
+        return heap.size() - cancelledCount;
+    }
+};
+
+// Очередь таймеров на иерархическом колесе: 4 уровня по 64 ячейки, ячейка уровня L
+// покрывает 64^L тиков. Элемент кладётся на уровень, где его срок впервые совпадает
+// с текущим временем по старшим разрядам, и опускается ниже, когда время доходит
+// до его ячейки. Сроки дальше 64^4 тиков ждут в отдельном списке. Ячейки - двусвязные
+// списки в общем пуле, поэтому постановка и отмена по дескриптору стоят O(1), а
+// маски занятых ячеек позволяют advance() перепрыгивать пустые участки времени.
+// Порядок элементов с одинаковым сроком не гарантируется.
+template <typename T>
+class TimerQueue {
+public:
+    struct Handle {
+        uint32_t index = UINT32_MAX;
+        uint32_t generation = 0;
+    };
+
+private:
+    static constexpr unsigned SlotBits = 6;
+    static constexpr unsigned Slots = 1u << SlotBits;
+    static constexpr unsigned Levels = 4;
+    static constexpr uint32_t OverflowList = Levels * Slots;
+    static constexpr uint32_t ExpiredList = OverflowList + 1;
+    static constexpr uint32_t ListCount = ExpiredList + 1;
+    static constexpr uint32_t NoList = UINT32_MAX;
+
+    // Первые ListCount записей пула - заголовки кольцевых списков
+    struct Entry {
+        std::optional<T> value;
+        uint64_t due = 0;
+        uint32_t prev = 0;
+        uint32_t next = 0;
+        uint32_t list = NoList;
+        uint32_t generation = 0;
+    };
+
+    std::vector<Entry> entries;
+    uint32_t freeHead = NoList;
+    std::array<uint64_t, Levels> occupied{};
+    uint64_t overflowDue = UINT64_MAX; // не больше самого раннего срока в отдельном списке
+    uint64_t current;
+    size_t pendingCount = 0;
+    size_t expiredCount = 0;
+
+    static unsigned slotIndex(uint64_t time, unsigned level) {
+        return static_cast<unsigned>(time >> (level * SlotBits)) & (Slots - 1);
+    }
+
+    bool listEmpty(uint32_t list) const {
+        return entries[list].next == list;
+    }
+
+    void link(uint32_t index, uint32_t list) {
+        Entry& entry = entries[index];
+        entry.list = list;
+        entry.prev = entries[list].prev;
+        entry.next = list;
+        entries[entry.prev].next = index;
+        entries[list].prev = index;
+        if (list < OverflowList)
+            occupied[list / Slots] |= uint64_t(1) << (list % Slots);
+        else if (list == OverflowList)
+            overflowDue = std::min(overflowDue, entry.due);
+        else if (list == ExpiredList)
+            expiredCount++;
+    }
+
+    void unlink(uint32_t index) {
+        Entry& entry = entries[index];
+        uint32_t list = entry.list;
+        entries[entry.prev].next = entry.next;
+        entries[entry.next].prev = entry.prev;
+        entry.list = NoList;
+        if (list < OverflowList && listEmpty(list))
+            occupied[list / Slots] &= ~(uint64_t(1) << (list % Slots));
+        else if (list == ExpiredList)
+            expiredCount--;
+    }
+
+    void place(uint32_t index) {
+        uint64_t due = entries[index].due;
+        if (due <= current) {
+            link(index, ExpiredList);
+            return;
+        }
+        for (unsigned level = 0; level < Levels; level++) {
+            unsigned shift = (level + 1) * SlotBits;
+            if ((due >> shift) == (current >> shift)) {
+                link(index, level * Slots + slotIndex(due, level));
+                return;
+            }
+        }
+        link(index, OverflowList);
+    }
+
+    // Перекладывает весь список заново относительно текущего времени. Список
+    // сначала отцепляется целиком, потому что часть элементов может вернуться в него же.
+    void redistribute(uint32_t list) {
+        if (listEmpty(list))
+            return;
+        uint32_t index = entries[list].next;
+        entries[entries[list].prev].next = NoList;
+        entries[list].prev = list;
+        entries[list].next = list;
+        if (list < OverflowList)
+            occupied[list / Slots] &= ~(uint64_t(1) << (list % Slots));
+        else if (list == OverflowList)
+            overflowDue = UINT64_MAX;
+        while (index != NoList) {
+            uint32_t next = entries[index].next;
+            place(index);
+            index = next;
+        }
+    }
+
+    void release(uint32_t index) {
+        Entry& entry = entries[index];
+        entry.value.reset();
+        entry.generation++;
+        entry.next = freeHead;
+        freeHead = index;
+    }
+
+    uint32_t allocate() {
+        if (freeHead != NoList) {
+            uint32_t index = freeHead;
+            freeHead = entries[index].next;
+            return index;
+        }
+        entries.emplace_back();
+        return static_cast<uint32_t>(entries.size() - 1);
+    }
+
+    T takeExpired() {
+        uint32_t index = entries[ExpiredList].next;
+        unlink(index);
+        T value = std::move(*entries[index].value);
+        release(index);
+        pendingCount--;
+        return value;
+    }
+
+public:
+    explicit TimerQueue(uint64_t start = 0) : entries(ListCount), current(start) {
+        for (uint32_t list = 0; list < ListCount; list++) {
+            entries[list].prev = list;
+            entries[list].next = list;
+        }
+    }
+
+    TimerQueue(const TimerQueue&) = delete;
+    TimerQueue& operator=(const TimerQueue&) = delete;
+
+    Handle schedule(uint64_t due, T value) {
+        uint32_t index = allocate();
+        entries[index].value.emplace(std::move(value));
+        entries[index].due = due;
+        place(index);
+        pendingCount++;
+        return Handle{index, entries[index].generation};
+    }
+
+    TimerQueue& operator<<(std::pair<uint64_t, T> timer) {
+        schedule(timer.first, std::move(timer.second));
+        return *this;
+    }
+
+    // Возвращает false, если элемент уже извлечён или отменён
+    bool cancel(Handle handle) {
+        if (handle.index < ListCount || handle.index >= entries.size())
+            return false;
+        Entry& entry = entries[handle.index];
+        if (entry.generation != handle.generation || entry.list == NoList)
+            return false;
+        unlink(handle.index);
+        release(handle.index);
+        pendingCount--;
+        return true;
+    }
+
+    // Сдвигает время вперёд до now; всё, что истекло, становится доступно dequeue
+    void advance(uint64_t now) {
+        while (current < now) {
+            unsigned position = slotIndex(current, 0);
+            uint64_t level0 = occupied[0] & (~uint64_t(0) << position);
+            if (level0) {
+                uint64_t due = (current & ~uint64_t(Slots - 1)) | static_cast<unsigned>(std::countr_zero(level0));
+                if (due > now)
+                    break;
+                current = due;
+                redistribute(due & (Slots - 1));
+                continue;
+            }
+
+            // Ближайшая ячейка старших уровней, до которой дойдёт время
+            uint64_t next = UINT64_MAX;
+            uint32_t list = NoList;
+            for (unsigned level = 1; level < Levels && list == NoList; level++) {
+                position = slotIndex(current, level);
+                uint64_t rest = position + 1 < Slots ? occupied[level] & (~uint64_t(0) << (position + 1)) : 0;
+                if (rest) {
+                    unsigned slot = static_cast<unsigned>(std::countr_zero(rest));
+                    unsigned shift = (level + 1) * SlotBits;
+                    next = ((current >> shift) << shift) | (uint64_t(slot) << (level * SlotBits));
+                    list = level * Slots + slot;
+                }
+            }
+            // Отдельный список разбирается сразу с начала окна самого раннего срока,
+            // без перебора пустых окон по 64^4 тиков
+            if (list == NoList && !listEmpty(OverflowList)) {
+                unsigned top = Levels * SlotBits;
+                next = (overflowDue >> top) << top;
+                list = OverflowList;
+            }
+            if (list == NoList || next > now)
+                break;
+            current = next;
+            redistribute(list);
+        }
+        current = std::max(current, now);
+    }
+
+    bool dequeue(T& value) {
+        if (expiredCount == 0)
+            return false;
+        value = takeExpired();
+        return true;
+    }
+
+    // Сдвигает время до now и забирает все истёкшие элементы
+    template <typename OutputIt>
+    size_t dequeue_due(uint64_t now, OutputIt out) {
+        advance(now);
+        size_t taken = 0;
+        while (expiredCount > 0) {
+            *out = takeExpired();
+            ++out;
+            taken++;
+        }
+        return taken;
+    }
+
+    uint64_t now() const {
+        return current;
+    }
+
+    size_t size() const {
+        return pendingCount;
+    }
+
+    size_t due() const {
+        return expiredCount;
+    }
+};
+
+// Планировщик, через который очереди возобновляют ожидающие корутины
+class CoroutineScheduler {
+public:
+    virtual ~CoroutineScheduler() {}
+    virtual void schedule(std::coroutine_handle<> handle) = 0;
+};
+
+// Исполнитель с очередью готовых корутин, которую разбирает вызывающий run()
+class ManualExecutor : public CoroutineScheduler {
+private:
+    std::mutex lock;
+    CommonQueue<std::coroutine_handle<>> ready;
+
+public:
+    void schedule(std::coroutine_handle<> handle) override {
+        std::lock_guard<std::mutex> guard(lock);
+        ready.enqueue(handle);
+    }
+
+    bool runOne() {
+        std::coroutine_handle<> handle;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (!ready.dequeue(handle))
+                return false;
+        }
+        handle.resume();
+        return true;
+    }
+
+    void run() {
+        while (runOne()) {}
     }
 };
 
-template <typename T>
-class CommonQueue {
-protected:
-    struct Node {
-        T data;
-        Node* next;
-        Node(const T& value) : data(value), next(nullptr) {}
+// Корутина, которая запускается сразу и уничтожается по завершении
+struct DetachedTask {
+    struct promise_type {
+        DetachedTask get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
     };
-    Node* front;
-    Node* rear;
-    size_t count;
+};
 
-    void clear() {
-        while (front) {
-            Node* temp = front;
-            front = front->next;
-            delete temp;
+// Ограниченная очередь для нескольких потоков. Потоки сначала недолго крутятся,
+// затем засыпают на условной переменной; корутины встают в списки ожидания и
+// возобновляются через планировщик, не занимая поток.
+template <typename T>
+class BlockingQueue {
+public:
+    class PopAwaiter;
+    class PushAwaiter;
+
+private:
+    static constexpr int SpinCount = 64;
+
+    mutable std::mutex lock;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    SegmentedStorage<T> items;
+    size_t capacity;
+    CommonQueue<PopAwaiter*> waitingPoppers;
+    CommonQueue<PushAwaiter*> waitingPushers;
+    CoroutineScheduler* scheduler;
+
+    void resume(std::coroutine_handle<> handle) {
+        if (!handle)
+            return;
+        if (scheduler)
+            scheduler->schedule(handle);
+        else
+            handle.resume();
+    }
+
+    // Вызывается под блокировкой. Возвращает корутину, которую нужно возобновить.
+    template <typename U>
+    std::coroutine_handle<> pushLocked(U&& value) {
+        PopAwaiter* popper;
+        if (waitingPoppers.dequeue(popper)) {
+            popper->value.emplace(std::forward<U>(value));
+            return popper->handle;
         }
-        front = rear = nullptr;
-        count = 0;
+        items.emplace_back(std::forward<U>(value));
+        notEmpty.notify_one();
+        return nullptr;
     }
 
-public:
-    CommonQueue() : front(nullptr), rear(nullptr), count(0) {}
-    virtual ~CommonQueue() {
-        clear();
+    template <typename Out>
+    std::coroutine_handle<> popLocked(Out& value) {
+        value = std::move(items.front());
+        items.pop_front();
+        PushAwaiter* pusher;
+        if (waitingPushers.dequeue(pusher)) {
+            items.emplace_back(std::move(pusher->value));
+            return pusher->handle;
+        }
+        notFull.notify_one();
+        return nullptr;
     }
 
-    void enqueue(const T& value) {
-        Node* newNode = new Node(value);
-        if (!rear) {
-            front = rear = newNode;
-        } else {
-            rear->next = newNode;
-            rear = newNode;
+    bool hasRoom() const {
+        return items.size() < capacity;
+    }
+
+    template <typename U>
+    bool tryPushImpl(U&& value) {
+        std::coroutine_handle<> handle;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (!hasRoom())
+                return false;
+            handle = pushLocked(std::forward<U>(value));
         }
-        count++;
+        resume(handle);
+        return true;
     }
 
-    bool dequeue(T& value) {
-        if (!front) 
+    template <typename U>
+    void pushWaitImpl(U&& value) {
+        for (int i = 0; i < SpinCount; i++) {
+            if (tryPushImpl(std::forward<U>(value)))
+                return;
+            std::this_thread::yield();
+        }
+        std::coroutine_handle<> handle;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            notFull.wait(guard, [this] { return hasRoom(); });
+            handle = pushLocked(std::forward<U>(value));
+        }
+        resume(handle);
+    }
+
+    template <typename U, typename Rep, typename Period>
+    bool pushForImpl(U&& value, const std::chrono::duration<Rep, Period>& timeout) {
+        std::coroutine_handle<> handle;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            if (!notFull.wait_for(guard, timeout, [this] { return hasRoom(); }))
+                return false;
+            handle = pushLocked(std::forward<U>(value));
+        }
+        resume(handle);
+        return true;
+    }
+
+public:
+    class PopAwaiter {
+    private:
+        friend class BlockingQueue;
+        BlockingQueue* queue;
+        std::optional<T> value;
+        std::coroutine_handle<> handle;
+
+    public:
+        explicit PopAwaiter(BlockingQueue* q) : queue(q) {}
+
+        bool await_ready() const noexcept {
             return false;
-        Node* temp = front;
-        value = front->data;
-        front = front->next;
-        if (!front) 
-            rear = nullptr;
-        delete temp;
-        count--;
+        }
+
+        bool await_suspend(std::coroutine_handle<> h) {
+            std::coroutine_handle<> pusher;
+            {
+                std::lock_guard<std::mutex> guard(queue->lock);
+                if (queue->items.empty()) {
+                    handle = h;
+                    queue->waitingPoppers.enqueue(this);
+                    return true;
+                }
+                pusher = queue->popLocked(value);
+            }
+            queue->resume(pusher);
+            return false;
+        }
+
+        T await_resume() {
+            return std::move(*value);
+        }
+    };
+
+    class PushAwaiter {
+    private:
+        friend class BlockingQueue;
+        BlockingQueue* queue;
+        T value;
+        std::coroutine_handle<> handle;
+
+    public:
+        PushAwaiter(BlockingQueue* q, T v) : queue(q), value(std::move(v)) {}
+
+        bool await_ready() const noexcept {
+            return false;
+        }
+
+        bool await_suspend(std::coroutine_handle<> h) {
+            std::coroutine_handle<> popper;
+            {
+                std::lock_guard<std::mutex> guard(queue->lock);
+                if (!queue->hasRoom()) {
+                    handle = h;
+                    queue->waitingPushers.enqueue(this);
+                    return true;
+                }
+                popper = queue->pushLocked(std::move(value));
+            }
+            queue->resume(popper);
+            return false;
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    explicit BlockingQueue(size_t maxSize, CoroutineScheduler* executor = nullptr)
+        : capacity(std::max<size_t>(maxSize, 1)), scheduler(executor) {}
+
+    BlockingQueue(const BlockingQueue&) = delete;
+    BlockingQueue& operator=(const BlockingQueue&) = delete;
+
+    bool try_push(const T& value) {
+        return tryPushImpl(value);
+    }
+
+    bool try_push(T&& value) {
+        return tryPushImpl(std::move(value));
+    }
+
+    void push_wait(const T& value) {
+        pushWaitImpl(value);
+    }
+
+    void push_wait(T&& value) {
+        pushWaitImpl(std::move(value));
+    }
+
+    template <typename Rep, typename Period>
+    bool push_for(const T& value, const std::chrono::duration<Rep, Period>& timeout) {
+        return pushForImpl(value, timeout);
+    }
+
+    template <typename Rep, typename Period>
+    bool push_for(T&& value, const std::chrono::duration<Rep, Period>& timeout) {
+        return pushForImpl(std::move(value), timeout);
+    }
+
+    bool try_pop(T& value) {
+        std::coroutine_handle<> handle;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (items.empty())
+                return false;
+            handle = popLocked(value);
+        }
+        resume(handle);
         return true;
     }
 
-    size_t size() const { 
-        return count; 
+    void pop_wait(T& value) {
+        for (int i = 0; i < SpinCount; i++) {
+            if (try_pop(value))
+                return;
+            std::this_thread::yield();
+        }
+        std::coroutine_handle<> handle;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            notEmpty.wait(guard, [this] { return !items.empty(); });
+            handle = popLocked(value);
+        }
+        resume(handle);
+    }
+
+    template <typename Rep, typename Period>
+    bool pop_for(T& value, const std::chrono::duration<Rep, Period>& timeout) {
+        std::coroutine_handle<> handle;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            if (!notEmpty.wait_for(guard, timeout, [this] { return !items.empty(); }))
+                return false;
+            handle = popLocked(value);
+        }
+        resume(handle);
+        return true;
+    }
+
+    // co_await queue.pop() возвращает извлечённый элемент
+    PopAwaiter pop() {
+        return PopAwaiter(this);
+    }
+
+    // co_await queue.push(value) приостанавливает корутину, пока нет места
+    PushAwaiter push(T value) {
+        return PushAwaiter(this, std::move(value));
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> guard(lock);
+        return items.size();
     }
 };
 
-template <typename T>
-class Queue : public CommonQueue<T> {
-public:
-    Queue<T>& operator<<(const T& value) {
-        this->enqueue(value);
-        return *this;
+DetachedTask produceNumbers(BlockingQueue<int>& queue, int count) {
+    for (int i = 1; i <= count; i++) {
+        co_await queue.push(i);
+    }
+}
+
+DetachedTask consumeNumbers(BlockingQueue<int>& queue, int count) {
+    for (int i = 0; i < count; i++) {
+        int value = co_await queue.pop();
+        std::cout << "Awaited int: " << value << std::endl;
     }
+}
+
+enum class DrawCompletion {
+    Unordered,
+    Ordered
 };
 
-template <>
-class Queue<int> : public CommonQueue<int> {
+struct DrawOptions {
+    size_t batchSize = 1024;
+    bool groupByType = false;
+    DrawCompletion completion = DrawCompletion::Unordered;
+    // Вызывается для каждого отрисованного пакета, всегда по одному (под блокировкой
+    // исполнителя), так что синхронизация внутри не нужна; в режиме Ordered - в порядке поступления
+    std::function<void(GraphicObject* const* objects, size_t count)> onBatchDrawn;
+};
+
+// Параллельная отрисовка очереди графических объектов. Очередь разбирается
+// пакетами, пакеты раздаются по декам рабочих потоков; простаивающий поток
+// забирает работу с противоположного конца чужого дека.
+class DrawExecutor {
+private:
+    struct Batch {
+        size_t index;
+        std::vector<GraphicObject*> objects;
+    };
+
+    struct Worker {
+        std::mutex lock;
+        std::deque<Batch> batches;
+        std::thread thread;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::mutex stateLock;
+    std::condition_variable workAvailable;
+    std::condition_variable allDone;
+    size_t queuedBatches;
+    size_t unfinishedBatches;
+    bool stopping;
+
+    const DrawOptions* options;
+    std::mutex retireLock;
+    std::vector<std::vector<GraphicObject*>> retained;
+    std::vector<char> finished;
+    size_t nextToRetire;
+
+    bool popLocal(Worker& worker, Batch& batch) {
+        std::lock_guard<std::mutex> guard(worker.lock);
+        if (worker.batches.empty())
+            return false;
+        batch = std::move(worker.batches.back());
+        worker.batches.pop_back();
+        return true;
+    }
+
+    bool steal(size_t self, Batch& batch) {
+        for (size_t i = 1; i < workers.size(); i++) {
+            Worker& victim = *workers[(self + i) % workers.size()];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (!victim.batches.empty()) {
+                batch = std::move(victim.batches.front());
+                victim.batches.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void retire(Batch& batch) {
+        if (!options->onBatchDrawn)
+            return;
+        std::lock_guard<std::mutex> guard(retireLock);
+        if (options->completion == DrawCompletion::Unordered) {
+            options->onBatchDrawn(batch.objects.data(), batch.objects.size());
+            return;
+        }
+        // Пакеты, завершившиеся раньше своей очереди, ждут в retained
+        retained[batch.index] = std::move(batch.objects);
+        finished[batch.index] = 1;
+        while (nextToRetire < finished.size() && finished[nextToRetire]) {
+            std::vector<GraphicObject*>& objects = retained[nextToRetire];
+            options->onBatchDrawn(objects.data(), objects.size());
+            std::vector<GraphicObject*>().swap(objects);
+            nextToRetire++;
+        }
+    }
+
+    void run(Batch& batch) {
+        if (options->groupByType) {
+            std::stable_sort(batch.objects.begin(), batch.objects.end(),
+                [](const GraphicObject* a, const GraphicObject* b) {
+                    return std::type_index(typeid(*a)) < std::type_index(typeid(*b));
+                });
+        }
+        for (const GraphicObject* object : batch.objects)
+            object->draw();
+        retire(batch);
+    }
+
+    void workerLoop(size_t self) {
+        Batch batch;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> guard(stateLock);
+                workAvailable.wait(guard, [this] { return stopping || queuedBatches > 0; });
+                if (stopping && queuedBatches == 0)
+                    return;
+                queuedBatches--;
+            }
+            // Счётчик гарантирует, что пакет есть в каком-то из деков
+            while (!popLocal(*workers[self], batch) && !steal(self, batch)) {
+                std::this_thread::yield();
+            }
+            run(batch);
+            std::lock_guard<std::mutex> guard(stateLock);
+            if (--unfinishedBatches == 0)
+                allDone.notify_all();
+        }
+    }
+
 public:
-    int sum() const {
-        int total = 0;
-        typename CommonQueue<int>::Node* current = this->front;
-        while (current) {
-            total += current->data;
-            current = current->next;
+    explicit DrawExecutor(size_t workerCount = std::thread::hardware_concurrency())
+        : queuedBatches(0), unfinishedBatches(0), stopping(false),
+          options(nullptr), nextToRetire(0) {
+        workerCount = std::max<size_t>(workerCount, 1);
+        for (size_t i = 0; i < workerCount; i++)
+            workers.push_back(std::make_unique<Worker>());
+        for (size_t i = 0; i < workerCount; i++)
+            workers[i]->thread = std::thread(&DrawExecutor::workerLoop, this, i);
+    }
+
+    DrawExecutor(const DrawExecutor&) = delete;
+    DrawExecutor& operator=(const DrawExecutor&) = delete;
+
+    ~DrawExecutor() {
+        {
+            std::lock_guard<std::mutex> guard(stateLock);
+            stopping = true;
+        }
+        workAvailable.notify_all();
+        for (auto& worker : workers)
+            worker->thread.join();
+    }
+
+    // Разбирает очередь целиком и возвращает управление, когда всё отрисовано
+    size_t drain(Queue<GraphicObject*>& queue, const DrawOptions& drawOptions) {
+        size_t batchSize = std::max<size_t>(drawOptions.batchSize, 1);
+        size_t total = queue.size();
+        size_t batchCount = (total + batchSize - 1) / batchSize;
+        if (batchCount == 0)
+            return 0;
+
+        options = &drawOptions;
+        bool ordered = drawOptions.completion == DrawCompletion::Ordered;
+        finished.assign(ordered ? batchCount : 0, 0);
+        retained.assign(ordered ? batchCount : 0, {});
+        nextToRetire = 0;
+        {
+            std::lock_guard<std::mutex> guard(stateLock);
+            unfinishedBatches = batchCount;
+        }
+
+        for (size_t index = 0; index < batchCount; index++) {
+            Batch batch;
+            batch.index = index;
+            batch.objects.reserve(batchSize);
+            queue.dequeue_n(std::back_inserter(batch.objects), batchSize);
+            Worker& worker = *workers[index % workers.size()];
+            {
+                std::lock_guard<std::mutex> guard(worker.lock);
+                worker.batches.push_back(std::move(batch));
+            }
+            {
+                std::lock_guard<std::mutex> guard(stateLock);
+                queuedBatches++;
+            }
+            workAvailable.notify_one();
         }
+
+        std::unique_lock<std::mutex> guard(stateLock);
+        allDone.wait(guard, [this] { return unfinishedBatches == 0; });
+        options = nullptr;
         return total;
     }
 
-    Queue<int>& operator<<(const int& value) {
-        this->enqueue(value);
-        return *this;
+    size_t drain(Queue<GraphicObject*>& queue) {
+        return drain(queue, DrawOptions());
     }
 };
 
-template <>
-class Queue<char> {
+#ifdef QUEUE_BENCH
+// Замеры производительности очередей: сборка с -DQUEUE_BENCH и запуск с ключом --bench.
+// Счётчики выделений памяти ведутся заменой глобальных operator new, поэтому
+// в обычную сборку этот раздел не попадает.
+std::atomic<size_t> allocatedBytes(0);
+std::atomic<size_t> allocationCount(0);
+// Результаты замеров пишутся сюда, чтобы компилятор не выбросил работу
+volatile size_t benchSink;
+
+void* countedAllocate(size_t size, size_t alignment) {
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    void* memory;
+    if (alignment <= alignof(std::max_align_t)) {
+        memory = std::malloc(size ? size : 1);
+    } else {
+        memory = std::aligned_alloc(alignment, (std::max<size_t>(size, 1) + alignment - 1) / alignment * alignment);
+    }
+    if (!memory)
+        throw std::bad_alloc();
+    return memory;
+}
+
+void* operator new(size_t size) {
+    return countedAllocate(size, alignof(std::max_align_t));
+}
+
+void* operator new[](size_t size) {
+    return countedAllocate(size, alignof(std::max_align_t));
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    return countedAllocate(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return countedAllocate(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+// Число промахов кэша через perf_event_open, если ядро его разрешает
+class CacheMissCounter {
 private:
-    char* data;
-    size_t capacity;
-    size_t head;
-    size_t tail;
-    size_t count;
+    int fd;
 
 public:
-    explicit Queue(size_t size = 100) 
-        : capacity(size), head(0), tail(0), count(0) {
-        data = new char[capacity];
+    CacheMissCounter() : fd(-1) {
+#ifdef __linux__
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = static_cast<int>(::syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
     }
 
-    ~Queue() {
-        delete[] data;
+    CacheMissCounter(const CacheMissCounter&) = delete;
+    CacheMissCounter& operator=(const CacheMissCounter&) = delete;
+
+    ~CacheMissCounter() {
+#ifdef __linux__
+        if (fd >= 0)
+            ::close(fd);
+#endif
     }
 
-    void enqueue(char value) {
-        if (count >= capacity) 
-            throw std::runtime_error("Queue is full");
-        data[tail] = value;
-        tail = (tail + 1) % capacity;
-        count++;
+    bool available() const {
+        return fd >= 0;
     }
 
-    bool dequeue(char& value) {
-        if (count == 0) 
-            return false;
-        value = data[head];
-        head = (head + 1) % capacity;
-        count--;
-        return true;
+    void start() {
+#ifdef __linux__
+        if (fd >= 0) {
+            ::ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ::ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
     }
 
-    Queue<char>& operator<<(char value) {
-        enqueue(value);
-        return *this;
+    long long stop() {
+        long long value = -1;
+#ifdef __linux__
+        if (fd >= 0) {
+            ::ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (::read(fd, &value, sizeof(value)) != sizeof(value))
+                value = -1;
+        }
+#endif
+        return value;
     }
+};
 
-    size_t size() const { 
-        return count; 
+struct BenchResult {
+    std::string name;
+    size_t ops;
+    double seconds;
+    size_t bytes;
+    size_t allocations;
+    long long cacheMisses;
+    LatencyHistogram latency;
+};
+
+void printBenchHeader() {
+    std::cout << std::left << std::setw(44) << "benchmark" << std::right
+              << std::setw(14) << "Mops/s" << std::setw(12) << "B/op" << std::setw(12) << "allocs/op"
+              << std::setw(12) << "miss/op" << std::setw(9) << "p50ns" << std::setw(9) << "p99ns"
+              << std::setw(10) << "p99.9ns" << std::endl;
+}
+
+void printBenchResult(const BenchResult& result) {
+    double ops = static_cast<double>(std::max<size_t>(result.ops, 1));
+    std::cout << std::left << std::setw(44) << result.name << std::right << std::fixed
+              << std::setprecision(2) << std::setw(14) << result.ops / result.seconds / 1e6
+              << std::setw(12) << result.bytes / ops << std::setw(12) << std::setprecision(4)
+              << result.allocations / ops << std::setw(12);
+    if (result.cacheMisses >= 0)
+        std::cout << std::setprecision(3) << result.cacheMisses / ops;
+    else
+        std::cout << "n/a";
+    if (result.latency.count() == 0) {
+        std::cout << std::setw(9) << "-" << std::setw(9) << "-" << std::setw(10) << "-" << std::endl;
+        return;
     }
+    std::cout << std::setw(9) << result.latency.percentile(0.5) << std::setw(9)
+              << result.latency.percentile(0.99) << std::setw(10) << result.latency.percentile(0.999)
+              << std::endl;
+}
+
+// Время одного вызова op() в наносекундах
+template <typename Op>
+void timeOp(LatencyHistogram& histogram, Op&& op) {
+    auto started = std::chrono::steady_clock::now();
+    op();
+    auto finished = std::chrono::steady_clock::now();
+    histogram.record(std::chrono::duration_cast<std::chrono::nanoseconds>(finished - started).count());
+}
+
+// Прогоняет нагрузку body() -> число операций, снимая время, выделения и промахи кэша
+template <typename Body>
+BenchResult measure(const std::string& name, CacheMissCounter& misses, Body&& body) {
+    BenchResult result;
+    result.name = name;
+    size_t bytesBefore = allocatedBytes.load();
+    size_t allocationsBefore = allocationCount.load();
+    misses.start();
+    auto started = std::chrono::steady_clock::now();
+    result.ops = body();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    result.cacheMisses = misses.stop();
+    result.bytes = allocatedBytes.load() - bytesBefore;
+    result.allocations = allocationCount.load() - allocationsBefore;
+    return result;
+}
+
+template <size_t N>
+struct Payload {
+    std::array<unsigned char, N> bytes;
 };
 
-template <>
-class Queue<const char*> {
-private:
-    struct Node {
-        char* data;
-        Node* next;
-        Node(const char* value) : next(nullptr) {
-            data = new char[std::strlen(value) + 1];
-            std::strcpy(data, value);
+template <typename T>
+T makeBenchValue(size_t i) {
+    if constexpr (std::is_arithmetic_v<T>) {
+        return static_cast<T>(i);
+    } else {
+        T value;
+        std::memset(&value, static_cast<int>(i), sizeof(value));
+        return value;
+    }
+}
+
+template <typename T>
+unsigned char benchDigest(const T& value) {
+    return *reinterpret_cast<const unsigned char*>(&value);
+}
+
+// Единый интерфейс для сравниваемых очередей
+template <typename T, typename Policy>
+void benchPush(Queue<T, Policy>& queue, const T& value) { queue.enqueue(value); }
+template <typename T, typename Policy>
+bool benchPop(Queue<T, Policy>& queue, T& value) { return queue.dequeue(value); }
+template <typename T>
+void benchPush(std::deque<T>& queue, const T& value) { queue.push_back(value); }
+template <typename T>
+bool benchPop(std::deque<T>& queue, T& value) {
+    if (queue.empty())
+        return false;
+    value = std::move(queue.front());
+    queue.pop_front();
+    return true;
+}
+template <typename T>
+void benchPush(std::queue<T>& queue, const T& value) { queue.push(value); }
+template <typename T>
+bool benchPop(std::queue<T>& queue, T& value) {
+    if (queue.empty())
+        return false;
+    value = std::move(queue.front());
+    queue.pop();
+    return true;
+}
+
+template <typename Q, typename T>
+void runSingleThreadBench(const std::string& name, size_t ops, CacheMissCounter& misses) {
+    const size_t steadyDepth = 64;
+    const size_t burstSize = 4096;
+    T value = makeBenchValue<T>(1);
+
+    BenchResult steady = measure(name + " steady", misses, [&]() {
+        Q queue;
+        for (size_t i = 0; i < steadyDepth; i++)
+            benchPush(queue, makeBenchValue<T>(i));
+        for (size_t i = 0; i < ops / 2; i++) {
+            benchPush(queue, value);
+            benchPop(queue, value);
         }
-        ~Node() { 
-            delete[] data; 
+        benchSink = benchDigest(value);
+        return ops / 2 * 2;
+    });
+    BenchResult burst = measure(name + " burst", misses, [&]() {
+        Q queue;
+        size_t done = 0;
+        while (done < ops) {
+            for (size_t i = 0; i < burstSize; i++)
+                benchPush(queue, value);
+            while (benchPop(queue, value)) {}
+            done += 2 * burstSize;
         }
-    };
-    Node* front;
-    Node* rear;
-    size_t count;
+        benchSink = benchDigest(value);
+        return done;
+    });
 
-public:
-    Queue() : front(nullptr), rear(nullptr), count(0) {}
-    ~Queue() {
-        while (front) {
-            Node* temp = front;
-            front = front->next;
-            delete temp;
-        }
+    // Задержки одной операции снимаются отдельным прогоном, чтобы чтение часов
+    // не искажало пропускную способность
+    Q queue;
+    for (size_t i = 0; i < steadyDepth; i++)
+        benchPush(queue, makeBenchValue<T>(i));
+    size_t samples = std::min<size_t>(ops / 2, 1 << 16);
+    for (size_t i = 0; i < samples; i++) {
+        auto t0 = std::chrono::steady_clock::now();
+        benchPush(queue, value);
+        auto t1 = std::chrono::steady_clock::now();
+        benchPop(queue, value);
+        auto t2 = std::chrono::steady_clock::now();
+        steady.latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count());
+        steady.latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count());
+    }
+    // Для пачек тот же замер, но очередь наполняется до burstSize и опустошается
+    Q burstQueue;
+    for (size_t recorded = 0; recorded < 2 * samples; recorded += 2 * burstSize) {
+        for (size_t i = 0; i < burstSize; i++)
+            timeOp(burst.latency, [&]() { benchPush(burstQueue, value); });
+        for (size_t i = 0; i < burstSize; i++)
+            timeOp(burst.latency, [&]() { benchPop(burstQueue, value); });
     }
+    benchSink = benchDigest(value);
+    printBenchResult(steady);
+    printBenchResult(burst);
+}
 
-    void enqueue(const char* value) {
-        Node* newNode = new Node(value);
-        if (!rear) {
-            front = rear = newNode;
-        } else {
-            rear->next = newNode;
-            rear = newNode;
+template <size_t N>
+void runPayloadBench(size_t ops, CacheMissCounter& misses) {
+    ops = std::max<size_t>(ops / std::max<size_t>(N / 16, 1), 1 << 12);
+    std::string suffix = "<" + std::to_string(N) + "B>";
+    runSingleThreadBench<Queue<Payload<N>>, Payload<N>>("CommonQueue" + suffix, ops, misses);
+    runSingleThreadBench<Queue<Payload<N>, QueueInstrumentation<>>, Payload<N>>(
+        "CommonQueue instrumented" + suffix, ops, misses);
+    runSingleThreadBench<std::deque<Payload<N>>, Payload<N>>("std::deque" + suffix, ops, misses);
+    runSingleThreadBench<std::queue<Payload<N>>, Payload<N>>("std::queue" + suffix, ops, misses);
+}
+
+void runStringBench(size_t ops, size_t length, CacheMissCounter& misses) {
+    const size_t burstSize = 4096;
+    std::string text(length, 's');
+    std::string suffix = "<" + std::to_string(length) + "B>";
+    size_t samples = std::min<size_t>(ops, 1 << 16);
+
+    BenchResult arena = measure("Queue<const char*> arena" + suffix, misses, [&]() {
+        Queue<const char*> queue;
+        std::string_view view;
+        size_t done = 0;
+        while (done < ops) {
+            for (size_t i = 0; i < burstSize; i++)
+                queue.enqueue(text.c_str());
+            while (queue.dequeue(view))
+                benchSink = view.size();
+            done += 2 * burstSize;
         }
-        count++;
+        return done;
+    });
+    // Задержки - отдельным прогоном тех же пачек
+    Queue<const char*> arenaQueue;
+    std::string_view view;
+    for (size_t recorded = 0; recorded < samples; recorded += 2 * burstSize) {
+        for (size_t i = 0; i < burstSize; i++)
+            timeOp(arena.latency, [&]() { arenaQueue.enqueue(text.c_str()); });
+        for (size_t i = 0; i < burstSize; i++)
+            timeOp(arena.latency, [&]() { arenaQueue.dequeue(view); });
     }
+    benchSink = view.size();
+    printBenchResult(arena);
 
-    bool dequeue(char*& output) {
-        if (!front) 
-            return false;
-        output = new char[std::strlen(front->data) + 1];
-        std::strcpy(output, front->data);
-
-        Node* temp = front;
-        front = front->next;
-        if (!front) 
-            rear = nullptr;
-        delete temp;
-        count--;
-        return true;
+    BenchResult strings = measure("std::queue<std::string>" + suffix, misses, [&]() {
+        std::queue<std::string> queue;
+        size_t done = 0;
+        while (done < ops) {
+            for (size_t i = 0; i < burstSize; i++)
+                queue.push(text);
+            while (!queue.empty()) {
+                benchSink = queue.front().size();
+                queue.pop();
+            }
+            done += 2 * burstSize;
+        }
+        return done;
+    });
+    std::queue<std::string> stringQueue;
+    for (size_t recorded = 0; recorded < samples; recorded += 2 * burstSize) {
+        for (size_t i = 0; i < burstSize; i++)
+            timeOp(strings.latency, [&]() { stringQueue.push(text); });
+        for (size_t i = 0; i < burstSize; i++) {
+            timeOp(strings.latency, [&]() {
+                benchSink = stringQueue.front().size();
+                stringQueue.pop();
+            });
+        }
     }
+    printBenchResult(strings);
+}
 
-    Queue<const char*>& operator<<(const char* value) {
-        enqueue(value);
-        return *this;
+// Эталон для многопоточных замеров: std::queue под мьютексом
+template <typename T>
+class LockedStdQueue {
+private:
+    std::mutex lock;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::queue<T> items;
+    size_t capacity;
+
+public:
+    explicit LockedStdQueue(size_t maxSize) : capacity(maxSize) {}
+
+    void push_wait(const T& value) {
+        std::unique_lock<std::mutex> guard(lock);
+        notFull.wait(guard, [this] { return items.size() < capacity; });
+        items.push(value);
+        notEmpty.notify_one();
     }
 
-    size_t size() const { 
-        return count; 
+    void pop_wait(T& value) {
+        std::unique_lock<std::mutex> guard(lock);
+        notEmpty.wait(guard, [this] { return !items.empty(); });
+        value = items.front();
+        items.pop();
+        notFull.notify_one();
     }
 };
 
-int main() {
+// Производители кладут метки времени, потребители считают задержку в очереди
+template <typename Q>
+void runProducerConsumerBench(const std::string& name, size_t producers, size_t consumers,
+                              size_t items, CacheMissCounter& misses) {
+    using Clock = std::chrono::steady_clock;
+    std::vector<LatencyHistogram> latencies(consumers);
+    items = items / (producers * consumers) * (producers * consumers);
+    BenchResult result = measure(name + " " + std::to_string(producers) + "P" +
+                                 std::to_string(consumers) + "C", misses, [&]() {
+        Q queue(1024);
+        std::vector<std::thread> threads;
+        for (size_t p = 0; p < producers; p++) {
+            threads.emplace_back([&queue, items, producers]() {
+                for (size_t i = 0; i < items / producers; i++)
+                    queue.push_wait(Clock::now().time_since_epoch().count());
+            });
+        }
+        for (size_t c = 0; c < consumers; c++) {
+            threads.emplace_back([&queue, &latencies, items, consumers, c]() {
+                long long stamp;
+                for (size_t i = 0; i < items / consumers; i++) {
+                    queue.pop_wait(stamp);
+                    latencies[c].record(Clock::now().time_since_epoch().count() - stamp);
+                }
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+        return 2 * items;
+    });
+    for (const auto& histogram : latencies)
+        result.latency.merge(histogram);
+    printBenchResult(result);
+}
+
+void runByteStreamBench(size_t bytes, size_t chunk, CacheMissCounter& misses) {
+    std::vector<char> source(chunk, 'b');
+    std::vector<char> target(chunk);
+    BenchResult result = measure("SpscByteQueue 1P1C <" + std::to_string(chunk) + "B writes>",
+                                 misses, [&]() {
+        SpscByteQueue pipe(1 << 20);
+        std::thread producer([&]() {
+            for (size_t sent = 0; sent < bytes; ) {
+                size_t length = pipe.write(std::span<const char>(source.data(), std::min(chunk, bytes - sent)));
+                if (length == 0)
+                    std::this_thread::yield();
+                sent += length;
+            }
+        });
+        for (size_t received = 0; received < bytes; ) {
+            size_t length = pipe.read(target);
+            if (length == 0)
+                std::this_thread::yield();
+            received += length;
+        }
+        producer.join();
+        return bytes / chunk;
+    });
+
+    // Задержки отдельных вызовов write() и read() - отдельным прогоном
+    LatencyHistogram writes;
+    size_t sampleBytes = std::min(bytes, chunk << 14);
+    SpscByteQueue pipe(1 << 20);
+    std::thread producer([&]() {
+        for (size_t sent = 0; sent < sampleBytes; ) {
+            size_t length = 0;
+            timeOp(writes, [&]() {
+                length = pipe.write(std::span<const char>(source.data(), std::min(chunk, sampleBytes - sent)));
+            });
+            if (length == 0)
+                std::this_thread::yield();
+            sent += length;
+        }
+    });
+    for (size_t received = 0; received < sampleBytes; ) {
+        size_t length = 0;
+        timeOp(result.latency, [&]() { length = pipe.read(target); });
+        if (length == 0)
+            std::this_thread::yield();
+        received += length;
+    }
+    producer.join();
+    result.latency.merge(writes);
+    printBenchResult(result);
+    std::cout << "    " << std::setprecision(2) << bytes / result.seconds / 1e9 << " GB/s" << std::endl;
+}
+
+void runBenchmarks(size_t ops) {
+    CacheMissCounter misses;
+    if (!misses.available())
+        std::cout << "perf_event_open unavailable, cache misses are not reported" << std::endl;
+    printBenchHeader();
+
+    runSingleThreadBench<Queue<int>, int>("Queue<int> aggregating", ops, misses);
+    runSingleThreadBench<Queue<char>, char>("Queue<char>", ops, misses);
+    runSingleThreadBench<std::deque<char>, char>("std::deque<char>", ops, misses);
+    runPayloadBench<1>(ops, misses);
+    runPayloadBench<8>(ops, misses);
+    runPayloadBench<64>(ops, misses);
+    runPayloadBench<256>(ops, misses);
+    runPayloadBench<1024>(ops, misses);
+    runStringBench(ops, 16, misses);
+    runStringBench(ops, 256, misses);
+
+    size_t items = std::max<size_t>(ops / 8, 1 << 12);
+    runProducerConsumerBench<BlockingQueue<long long>>("BlockingQueue", 1, 1, items, misses);
+    runProducerConsumerBench<LockedStdQueue<long long>>("mutex+std::queue", 1, 1, items, misses);
+    runProducerConsumerBench<BlockingQueue<long long>>("BlockingQueue", 2, 2, items, misses);
+    runProducerConsumerBench<LockedStdQueue<long long>>("mutex+std::queue", 2, 2, items, misses);
+    runByteStreamBench(ops * 64, 4096, misses);
+}
+#endif
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string_view(argv[1]) == "--bench") {
+#ifdef QUEUE_BENCH
+        size_t ops = argc > 2 ? std::stoul(argv[2]) : 1 << 22;
+        runBenchmarks(ops);
+#else
+        std::cout << "Benchmarks are not compiled in, rebuild with -DQUEUE_BENCH" << std::endl;
+#endif
+        return 0;
+    }
+
     // Демонстрация для int (с исправлением)
     Queue<int> intQueue;
     intQueue << 10 << 20 << 30;
@@ -227,6 +2932,35 @@ int main() {
     intQueue << 40 << 50;
     std::cout << "Sum of new ints: " << intQueue.sum() << std::endl;
     
+    // Скользящее окно из трёх последних замеров с минимумом за O(1)
+    AggregatingQueue<int, MinMonoid<int>> latencyWindow;
+    int latencies[] = {12, 7, 9, 15, 4, 11};
+    for (int latency : latencies) {
+        latencyWindow.enqueue(latency);
+        int expired;
+        if (latencyWindow.size() > 3)
+            latencyWindow.dequeue(expired);
+        std::cout << "Window min latency: " << latencyWindow.aggregate() << std::endl;
+    }
+
+    // При отставании потребителя элементы сверх порога уходят в файлы сегментов
+    SpillingQueue<int> burstQueue(4, 4);
+    for (int i = 1; i <= 12; i++) {
+        burstQueue << i * i;
+    }
+    std::cout << "Spilled to disk: " << burstQueue.spilled() << " of " << burstQueue.size() << std::endl;
+    int burstValue;
+    while (burstQueue.dequeue(burstValue)) {
+        std::cout << "Dequeued burst int: " << burstValue << std::endl;
+    }
+
+    // Очередь со счётчиками и выборочными замерами времени ожидания
+    Queue<int, QueueInstrumentation<1>> trackedQueue("tracked");
+    trackedQueue << 1 << 2 << 3;
+    int trackedValue;
+    while (trackedQueue.dequeue(trackedValue)) {}
+    QueueRegistry::instance().exportText(std::cout);
+
     // Демонстрация для char
     Queue<char> charQueue(5);
     charQueue << 'A' << 'B' << 'C';
@@ -235,23 +2969,85 @@ int main() {
         std::cout << "Dequeued char: " << charValue << std::endl;
     }
 
+    // Передача байтового потока между двумя потоками
+    SpscByteQueue pipe(16);
+    const std::string_view message = "Bytes through SPSC pipe";
+    std::thread producer([&pipe, message]() {
+        size_t sent = 0;
+        while (sent < message.size()) {
+            std::span<char> region = pipe.reserve(message.size() - sent);
+            std::memcpy(region.data(), message.data() + sent, region.size());
+            pipe.commit(region.size());
+            sent += region.size();
+        }
+    });
+    std::string received;
+    char chunk[8];
+    while (received.size() < message.size()) {
+        size_t length = pipe.read(chunk);
+        received.append(chunk, length);
+    }
+    producer.join();
+    std::cout << "Received: " << received << std::endl;
+
+    // Корутины обмениваются через ограниченную очередь без отдельных потоков
+    ManualExecutor executor;
+    BlockingQueue<int> boundedQueue(2, &executor);
+    produceNumbers(boundedQueue, 5);
+    consumeNumbers(boundedQueue, 5);
+    executor.run();
+
     // Демонстрация для const char*
     Queue<const char*> strQueue;
     strQueue << "Hello" << "World";
-    char* strValue;
+    std::string_view strValue;
     while (strQueue.dequeue(strValue)) {
         std::cout << "Dequeued string: " << strValue << std::endl;
-        delete[] strValue;
+    }
+
+    // Перемещение и пакетные операции для тяжёлых объектов
+    Queue<std::string> wordQueue;
+    std::string word = "moved";
+    wordQueue << std::move(word);
+    wordQueue.emplace(3, 'x');
+    std::vector<std::string> batch = {"alpha", "beta", "gamma"};
+    wordQueue.enqueue_range(std::make_move_iterator(batch.begin()),
+                            std::make_move_iterator(batch.end()));
+    std::vector<std::string> words;
+    wordQueue.dequeue_n(std::back_inserter(words), wordQueue.size());
+    for (const auto& w : words) {
+        std::cout << "Dequeued word: " << w << std::endl;
+    }
+
+    // Задачи по приоритету и по сроку; отменённые не извлекаются
+    PriorityQueue<int> priorities;
+    priorities << 5 << 1 << 4;
+    auto urgent = priorities.enqueue(0);
+    priorities.cancel(urgent);
+    int priority;
+    while (priorities.dequeue(priority)) {
+        std::cout << "Dequeued priority: " << priority << std::endl;
+    }
+
+    TimerQueue<std::string> timers;
+    timers << std::pair<uint64_t, std::string>(30, "report") << std::pair<uint64_t, std::string>(10, "ping");
+    auto retry = timers.schedule(5000, "retry");
+    timers.cancel(retry);
+    std::vector<std::string> fired;
+    for (uint64_t tick : {20, 40}) {
+        fired.clear();
+        timers.dequeue_due(tick, std::back_inserter(fired));
+        for (const auto& name : fired) {
+            std::cout << "Timer fired at " << tick << ": " << name << std::endl;
+        }
     }
 
     // Демонстрация для указателей на графические объекты
     Queue<GraphicObject*> objQueue;
     Circle circle1, circle2;
     objQueue << &circle1 << &circle2;
-    GraphicObject* objValue;
-    while (objQueue.dequeue(objValue)) {
-        objValue->draw();
-    }
+    DrawExecutor drawExecutor;
+    drawExecutor.drain(objQueue);
 
     return 0;
 }
\ No newline at end of file